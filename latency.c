@@ -0,0 +1,205 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include "latency.h"
+
+#define LATENCY_LINEAR 16           /* values with a bucket of their own */
+#define LATENCY_SUB_BITS 3          /* log2 of buckets per power of two */
+
+static const char *phase_names[LATENCY_PHASES] = {
+    "CONNECTING", "RESOLVE", "TCP_CONNECT", "WAIT", "AUTH",
+    "GET_CONFIG", "ASSIGN_IP", "ADD_ROUTES", "TOTAL"
+};
+
+void
+latency_stats_init(latency_stats_t *ls)
+{
+    memset(ls, 0, sizeof(*ls));
+    ls->version = LATENCY_VERSION;
+}
+
+void
+latency_timer_reset(latency_timer_t *lt)
+{
+    memset(lt, 0, sizeof(*lt));
+    lt->phase = -1;
+}
+
+const char *
+latency_phase_name(latency_phase_t phase)
+{
+    return phase_names[phase];
+}
+
+static int
+bucket_index(unsigned long long value)
+{
+    int e = 0;
+
+    if (value < LATENCY_LINEAR)
+    {
+        return (int) value;
+    }
+    while ((value >> e) > 1)
+    {
+        e++;
+    }
+    /* e >= 4: the 3 bits below the leading one select the sub-bucket */
+    int i = LATENCY_LINEAR + ((e - 4) << LATENCY_SUB_BITS)
+            + (int) ((value >> (e - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1));
+
+    return i < LATENCY_BUCKETS ? i : LATENCY_BUCKETS - 1;
+}
+
+/* largest value that falls in bucket i */
+static unsigned long long
+bucket_upper(int i)
+{
+    if (i < LATENCY_LINEAR)
+    {
+        return i;
+    }
+    i -= LATENCY_LINEAR;
+
+    int shift = (i >> LATENCY_SUB_BITS) + 4 - LATENCY_SUB_BITS;
+    unsigned long long sub = (1 << LATENCY_SUB_BITS) + (i & ((1 << LATENCY_SUB_BITS) - 1));
+
+    return ((sub + 1) << shift) - 1;
+}
+
+void
+latency_add(latency_hist_t *h, unsigned long long value)
+{
+    unsigned int *count = &h->count[bucket_index(value)];
+
+    if (*count < (unsigned int) -1)
+    {
+        (*count)++;
+    }
+}
+
+unsigned long
+latency_count(const latency_hist_t *h)
+{
+    unsigned long n = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        n += h->count[i];
+    }
+    return n;
+}
+
+unsigned long long
+latency_percentile(const latency_hist_t *h, double p)
+{
+    unsigned long n = latency_count(h);
+    unsigned long seen = 0;
+
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    /* rank of the value wanted, rounded up */
+    unsigned long rank = (unsigned long) (p * n);
+    if (rank < p * n || rank == 0)
+    {
+        rank++;
+    }
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += h->count[i];
+        if (seen >= rank)
+        {
+            return bucket_upper(i);
+        }
+    }
+    return bucket_upper(LATENCY_BUCKETS - 1);
+}
+
+/* the phase a daemon state starts or -1 */
+static int
+state_phase(const char *state)
+{
+    if (!strcmp(state, "RECONNECTING"))
+    {
+        return latency_connecting;
+    }
+    if (!strcmp(state, "AUTH_PENDING"))
+    {
+        return latency_auth;
+    }
+    for (int i = 0; i < latency_total; i++)
+    {
+        if (!strcmp(state, phase_names[i]))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int
+latency_state_change(latency_stats_t *ls, latency_timer_t *lt, const char *state,
+                     unsigned long long now)
+{
+    int phase = state_phase(state);
+    int completed = 0;
+
+    if (phase < 0 && strcmp(state, "CONNECTED") && strcmp(state, "EXITING"))
+    {
+        return 0;   /* not a step of connecting */
+    }
+    if (phase == lt->phase && phase != latency_connecting)
+    {
+        return 0;   /* the same phase goes on, e.g. AUTH_PENDING after AUTH */
+    }
+
+    if (lt->phase >= 0 && now >= lt->phase_start)
+    {
+        latency_add(&ls->phase[lt->phase], now - lt->phase_start);
+    }
+
+    if (phase == latency_connecting)
+    {
+        lt->in_attempt = 1;
+        lt->attempt_start = now;
+    }
+    else if (phase < 0)
+    {
+        if (lt->in_attempt && !strcmp(state, "CONNECTED") && now >= lt->attempt_start)
+        {
+            latency_add(&ls->phase[latency_total], now - lt->attempt_start);
+            completed = 1;
+        }
+        lt->in_attempt = 0;
+    }
+
+    lt->phase = lt->in_attempt ? phase : -1;
+    lt->phase_start = now;
+
+    return completed;
+}
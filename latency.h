@@ -0,0 +1,96 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/*
+ * Histograms of the time spent in each phase of connecting, built from
+ * the state changes reported by the daemon. Buckets are log-linear:
+ * exact below 16 ms, then 8 per power of two, so that any value is
+ * known within 12.5%. This module has no Windows dependency.
+ */
+
+/* phases of a connection attempt, named after the daemon states */
+typedef enum {
+    latency_connecting,         /* CONNECTING or RECONNECTING */
+    latency_resolve,
+    latency_tcp_connect,
+    latency_wait,
+    latency_auth,               /* AUTH and AUTH_PENDING */
+    latency_get_config,
+    latency_assign_ip,
+    latency_add_routes,
+    latency_total               /* from CONNECTING or RECONNECTING to CONNECTED */
+} latency_phase_t;
+
+#define LATENCY_PHASES (latency_total + 1)
+#define LATENCY_BUCKETS 176         /* covers values up to 2^24 ms, about 4.6 hours */
+#define LATENCY_VERSION 1           /* changes with the layout of latency_stats_t */
+
+typedef struct {
+    unsigned int count[LATENCY_BUCKETS];
+} latency_hist_t;
+
+/* all histograms of a profile: saved and restored as is */
+typedef struct {
+    unsigned int version;
+    latency_hist_t phase[LATENCY_PHASES];
+} latency_stats_t;
+
+/* timing of the attempt in progress */
+typedef struct {
+    int phase;                      /* phase being timed or -1 */
+    int in_attempt;                 /* an attempt started and has not completed */
+    unsigned long long phase_start; /* times in msec */
+    unsigned long long attempt_start;
+} latency_timer_t;
+
+/* empty histograms */
+void latency_stats_init(latency_stats_t *ls);
+
+/* stop timing until the next attempt starts */
+void latency_timer_reset(latency_timer_t *lt);
+
+/*
+ * Account for a change to the named daemon state at time now (msec):
+ * the time since the previous change is added to the phase that ended.
+ * An attempt ends on CONNECTED or EXITING, other states not named by a
+ * phase are ignored. Returns 1 if this completed an attempt.
+ */
+int latency_state_change(latency_stats_t *ls, latency_timer_t *lt, const char *state,
+                         unsigned long long now);
+
+/* add one value in msec */
+void latency_add(latency_hist_t *h, unsigned long long value);
+
+/* number of values added */
+unsigned long latency_count(const latency_hist_t *h);
+
+/*
+ * The value below which a fraction p (0 < p <= 1) of the values fall,
+ * as the upper end of its bucket. 0 if there are no values.
+ */
+unsigned long long latency_percentile(const latency_hist_t *h, double p);
+
+/* name of a phase for display */
+const char *latency_phase_name(latency_phase_t phase);
+
+#endif /* ifndef LATENCY_H */
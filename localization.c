@@ -197,79 +197,191 @@ LocalizedTime(const time_t t, LPTSTR buf, size_t size)
     return LocalizedSystemTime(&st, buf, size);
 }
 
-static int
-LoadStringLang(UINT stringId, LANGID langId, PTSTR buffer, int bufferSize, va_list args)
-{
-    PWCH entry;
-    PTSTR resBlockId = MAKEINTRESOURCE(stringId / 16 + 1);
-    int resIndex = stringId & 15;
+/* String resources are grouped in blocks of 16: ids up to 16*STRING_BLOCKS-1 are cached */
+#define STRING_BLOCKS 256
+
+/*
+ * The strings of one resource block, nul terminated, with the language
+ * fallback resolved. str[i] is NULL if string i is not defined at all.
+ */
+typedef struct {
+    const WCHAR *str[16];
+    WCHAR text[];
+} string_block_t;
+
+/*
+ * Strings of a language, blocks loaded on first use. Once published
+ * a table and its blocks are never modified or freed, so readers
+ * need no locks. A table is replaced when the GUI language changes.
+ */
+typedef struct {
+    LANGID langId;
+    string_block_t *volatile blocks[STRING_BLOCKS];
+} string_table_t;
+
+static string_table_t *volatile string_table;
 
-    /* find resource block for string */
+/* first entry of string resource block in the given language or NULL */
+static PWCH
+LoadStringBlock(PTSTR resBlockId, LANGID langId)
+{
     HRSRC res = FindResourceLang(RT_STRING, resBlockId, langId);
     if (res == NULL)
     {
-        goto err;
+        return NULL;
     }
+    return (PWCH) LoadResource(o.hInstance, res);
+}
+
+/* copy a block of strings taking missing entries from the default language */
+static string_block_t *
+NewStringBlock(UINT block, LANGID langId)
+{
+    PTSTR resBlockId = MAKEINTRESOURCE(block + 1);
+    PWCH entries[2] = { LoadStringBlock(resBlockId, langId), NULL };
+    PWCH found[16] = { NULL };
+    size_t len = 0;
 
-    /* get pointer to first entry in resource block */
-    entry = (PWCH) LoadResource(o.hInstance, res);
-    if (entry == NULL)
+    if (langId != fallbackLangId)
     {
-        goto err;
+        entries[1] = LoadStringBlock(resBlockId, fallbackLangId);
     }
 
-    /* search for string in block */
-    for (int i = 0; i < 16; i++)
+    /* each entry is a length followed by that many characters */
+    for (int k = 0; k < _countof(entries); k++)
     {
-        /* skip over this entry */
-        if (i != resIndex)
+        PWCH entry = entries[k];
+        for (int i = 0; entry && i < 16; entry += *entry + 1, i++)
         {
-            entry += ((*entry) + 1);
-            continue;
+            if (!found[i] && *entry != 0)
+            {
+                found[i] = entry;
+                len += *entry + 1;
+            }
         }
+    }
 
-        /* string does not exist */
-        if (i == resIndex && *entry == 0)
+    string_block_t *sb = calloc(1, sizeof(*sb) + len * sizeof(WCHAR));
+    if (!sb)
+    {
+        return NULL;
+    }
+
+    WCHAR *p = sb->text;
+    for (int i = 0; i < 16; i++)
+    {
+        if (found[i])
         {
-            break;
+            wmemcpy(p, found[i] + 1, *found[i]);
+            p[*found[i]] = L'\0';
+            sb->str[i] = p;
+            p += *found[i] + 1;
         }
+    }
+    return sb;
+}
+
+/* the string table of the GUI language */
+static string_table_t *
+GetStringTable(void)
+{
+    LANGID langId = GetGUILanguage();
+    string_table_t *st = string_table;
+
+    if (st && st->langId == langId)
+    {
+        return st;
+    }
+
+    string_table_t *new_st = calloc(1, sizeof(*new_st));
+    if (!new_st)
+    {
+        return NULL;
+    }
+    new_st->langId = langId;
+
+    /* a table replaced or added by another thread may still be in use: never free it */
+    if (InterlockedCompareExchangePointer((PVOID *) &string_table, new_st, st) != st)
+    {
+        free(new_st);
+        st = string_table;
+        return (st && st->langId == langId) ? st : NULL;
+    }
+    return new_st;
+}
 
-        /* string found, copy it */
-        PTSTR formatStr = (PTSTR) malloc((*entry + 1) * sizeof(TCHAR));
-        if (formatStr == NULL)
+/*
+ * Format string stringId of the GUI language or NULL if not defined.
+ * stringId must be below 16*STRING_BLOCKS.
+ */
+static const WCHAR *
+GetStringFormat(UINT stringId)
+{
+    UINT block = stringId / 16;
+    string_table_t *st = GetStringTable();
+
+    if (!st)
+    {
+        return NULL;
+    }
+
+    string_block_t *sb = st->blocks[block];
+    if (!sb)
+    {
+        sb = NewStringBlock(block, st->langId);
+        if (!sb)
         {
-            break;
+            return NULL;
+        }
+        /* if another thread got there first use its copy */
+        string_block_t *prev = InterlockedCompareExchangePointer((PVOID *) &st->blocks[block], sb, NULL);
+        if (prev)
+        {
+            free(sb);
+            sb = prev;
         }
-        formatStr[*entry] = 0;
-
-        wcsncpy(formatStr, entry + 1, *entry);
-        _vsntprintf(buffer, bufferSize, formatStr, args);
-        buffer[bufferSize - 1] = 0;
-        free(formatStr);
-        return _tcslen(buffer);
     }
+    return sb->str[stringId & 15];
+}
 
-err:
-    /* not found, try again with the default language */
-    if (langId != fallbackLangId)
+static int
+LoadStringLang(UINT stringId, LANGID langId, PTSTR buffer, int bufferSize, va_list args)
+{
+    string_block_t *sb = NULL;
+    const WCHAR *format;
+    int len = 0;
+
+    if (langId == GetGUILanguage() && stringId / 16 < STRING_BLOCKS)
     {
-        return LoadStringLang(stringId, fallbackLangId, buffer, bufferSize, args);
+        format = GetStringFormat(stringId);
+    }
+    else /* other languages and ids past the table are not cached */
+    {
+        sb = NewStringBlock(stringId / 16, langId);
+        format = sb ? sb->str[stringId & 15] : NULL;
     }
 
-    return 0;
+    if (format)
+    {
+        _vsntprintf(buffer, bufferSize, format, args);
+        buffer[bufferSize - 1] = 0;
+        len = _tcslen(buffer);
+    }
+    free(sb);
+    return len;
 }
 
 
 static PTSTR
 __LoadLocalizedString(const UINT stringId, va_list args)
 {
-    static TCHAR msg[512];
+    /* one buffer per thread: the result is valid until the next call by the same thread */
+    static THREAD_LOCAL TCHAR msg[512];
     msg[0] = 0;
     LoadStringLang(stringId, GetGUILanguage(), msg, _countof(msg), args);
     return msg;
 }
 
-
 PTSTR
 LoadLocalizedString(const UINT stringId, ...)
 {
@@ -0,0 +1,364 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "log_store.h"
+
+#define LOG_STORE_MIN_LINES 64
+#define LOG_STORE_MIN_CHARS (4*LOG_STORE_MAX_LINE)
+#define LOG_STORE_LINE_CHARS 128        /* average line length the text ring is sized for */
+#define LOG_WRITER_MIN_CHARS 1024
+
+void
+log_store_init(log_store_t *ls, size_t max_lines)
+{
+    memset(ls, 0, sizeof(*ls));
+    ls->max_lines = max_lines ? max_lines : 1;
+    ls->max_chars = max_lines * LOG_STORE_LINE_CHARS;
+    if (ls->max_chars < LOG_STORE_MIN_CHARS)
+    {
+        ls->max_chars = LOG_STORE_MIN_CHARS;
+    }
+}
+
+void
+log_store_free(log_store_t *ls)
+{
+    free(ls->rec);
+    free(ls->text);
+    memset(ls, 0, sizeof(*ls));
+}
+
+int
+log_parse_mgmt_line(const char *line, time_t *timestamp, log_class_t *class,
+                    const char **message)
+{
+    const char *flags = strchr(line, ',');
+    if (!flags)
+    {
+        return 0;
+    }
+    flags++;
+
+    const char *msg = strchr(flags, ',');
+    if (!msg)
+    {
+        return 0;
+    }
+    size_t flag_size = msg - flags;
+
+    if (memchr(flags, 'N', flag_size) || memchr(flags, 'F', flag_size))
+    {
+        *class = log_class_error;
+    }
+    else if (memchr(flags, 'W', flag_size))
+    {
+        *class = log_class_warning;
+    }
+    else
+    {
+        *class = log_class_normal;
+    }
+
+    *timestamp = strtol(line, NULL, 10);
+    *message = msg + 1;
+    return 1;
+}
+
+log_class_t
+log_classify_prefix(const wchar_t *prefix)
+{
+    if (wcsstr(prefix, L"ERROR"))
+    {
+        return log_class_error;
+    }
+    else if (wcsstr(prefix, L"WARNING"))
+    {
+        return log_class_warning;
+    }
+    return log_class_normal;
+}
+
+/* drop the oldest record */
+static void
+evict_oldest(log_store_t *ls)
+{
+    ls->rec_head = (ls->rec_head + 1) % ls->rec_cap;
+    ls->first_seq++;
+    if (--ls->count == 0)
+    {
+        ls->text_head = ls->text_tail = 0;
+    }
+    else
+    {
+        ls->text_head = ls->rec[ls->rec_head].offset;
+    }
+}
+
+/*
+ * Move the records and their text to new buffers of the given sizes,
+ * oldest first starting at index 0. Either size may be unchanged.
+ */
+static int
+relocate(log_store_t *ls, size_t rec_cap, size_t text_size)
+{
+    log_record_t *rec = malloc(rec_cap * sizeof(*rec));
+    wchar_t *text = text_size ? malloc(text_size * sizeof(*text)) : NULL;
+    size_t len = 0;
+    size_t i;
+
+    if (!rec || (text_size && !text))
+    {
+        free(rec);
+        free(text);
+        return 0;
+    }
+
+    for (i = 0; i < ls->count; i++)
+    {
+        rec[i] = ls->rec[(ls->rec_head + i) % ls->rec_cap];
+        memcpy(text + len, ls->text + rec[i].offset, rec[i].len * sizeof(*text));
+        rec[i].offset = len;
+        len += rec[i].len;
+    }
+
+    free(ls->rec);
+    free(ls->text);
+    ls->rec = rec;
+    ls->rec_cap = rec_cap;
+    ls->rec_head = 0;
+    ls->text = text;
+    ls->text_size = text_size;
+    ls->text_head = 0;
+    ls->text_tail = len;
+    return 1;
+}
+
+/* offset where a line of need characters fits or -1 */
+static size_t
+text_fit(const log_store_t *ls, size_t need)
+{
+    size_t usable = ls->text_size ? ls->text_size - 1 : 0;
+
+    if (ls->count == 0 || ls->text_head < ls->text_tail)
+    {
+        if (usable - ls->text_tail >= need)
+        {
+            return ls->text_tail;
+        }
+        else if (ls->text_head >= need) /* wrap around */
+        {
+            return 0;
+        }
+    }
+    else if (ls->text_head - ls->text_tail >= need)
+    {
+        return ls->text_tail;
+    }
+    return (size_t) -1;
+}
+
+wchar_t *
+log_store_reserve(log_store_t *ls, size_t max_len)
+{
+    size_t need = max_len + 1; /* the newline */
+    size_t pos;
+
+    if (max_len > LOG_STORE_MAX_LINE)
+    {
+        return NULL;
+    }
+
+    if (ls->count == ls->rec_cap)
+    {
+        if (ls->rec_cap < ls->max_lines)
+        {
+            size_t cap = ls->rec_cap ? 2*ls->rec_cap : LOG_STORE_MIN_LINES;
+            if (cap > ls->max_lines)
+            {
+                cap = ls->max_lines;
+            }
+            if (!relocate(ls, cap, ls->text_size))
+            {
+                return NULL;
+            }
+        }
+        else
+        {
+            evict_oldest(ls);
+        }
+    }
+
+    while ((pos = text_fit(ls, need)) == (size_t) -1)
+    {
+        if (ls->text_size < ls->max_chars + 1)
+        {
+            size_t size = ls->text_size ? 2*(ls->text_size - 1) : LOG_STORE_MIN_CHARS;
+            if (size > ls->max_chars)
+            {
+                size = ls->max_chars;
+            }
+            if (!relocate(ls, ls->rec_cap, size + 1))
+            {
+                return NULL;
+            }
+        }
+        else
+        {
+            evict_oldest(ls);
+        }
+    }
+
+    ls->reserved = pos;
+    return ls->text + pos;
+}
+
+void
+log_store_commit(log_store_t *ls, size_t len, time_t timestamp,
+                 log_class_t class, int flags)
+{
+    log_record_t *rec = &ls->rec[(ls->rec_head + ls->count) % ls->rec_cap];
+    wchar_t *text = ls->text + ls->reserved;
+    size_t i, j;
+
+    /* collapse CR LF pairs into a single newline, including a trailing CR */
+    for (i = j = 0; i < len; i++)
+    {
+        if (text[i] != L'\r' || (i + 1 < len && text[i + 1] != L'\n'))
+        {
+            text[j++] = text[i];
+        }
+    }
+    len = j;
+
+    rec->timestamp = timestamp;
+    rec->offset = ls->reserved;
+    rec->len = len + 1;
+    rec->class = class;
+    rec->flags = flags;
+
+    ls->text[ls->reserved + len] = L'\n';
+    ls->text_tail = ls->reserved + len + 1;
+    ls->count++;
+}
+
+int
+log_store_append(log_store_t *ls, time_t timestamp, log_class_t class, int flags,
+                 const wchar_t *datetime, const wchar_t *prefix, const wchar_t *message)
+{
+    const wchar_t *parts[] = { datetime, prefix, message };
+    size_t part_len[sizeof(parts)/sizeof(parts[0])];
+    size_t len = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(parts)/sizeof(parts[0]); i++)
+    {
+        part_len[i] = parts[i] ? wcslen(parts[i]) : 0;
+        if (part_len[i] > LOG_STORE_MAX_LINE - len)
+        {
+            part_len[i] = LOG_STORE_MAX_LINE - len;
+        }
+        len += part_len[i];
+    }
+
+    wchar_t *p = log_store_reserve(ls, len);
+    if (!p)
+    {
+        return 0;
+    }
+    for (i = 0; i < sizeof(parts)/sizeof(parts[0]); i++)
+    {
+        if (part_len[i])
+        {
+            wmemcpy(p, parts[i], part_len[i]);
+            p += part_len[i];
+        }
+    }
+    log_store_commit(ls, len, timestamp, class, flags);
+    return 1;
+}
+
+int
+log_writer_append(log_writer_t *lw, const wchar_t *datetime, const wchar_t *prefix,
+                  const wchar_t *message)
+{
+    const wchar_t *parts[] = { datetime, prefix, message };
+    size_t part_len[sizeof(parts)/sizeof(parts[0])];
+    size_t len = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(parts)/sizeof(parts[0]); i++)
+    {
+        part_len[i] = parts[i] ? wcslen(parts[i]) : 0;
+        len += part_len[i];
+    }
+
+    /* room for the line, its newline and the terminating nul */
+    size_t needed = lw->len + len + 2;
+    if (needed > lw->size)
+    {
+        size_t size = lw->size ? lw->size : LOG_WRITER_MIN_CHARS;
+        while (size < needed)
+        {
+            size *= 2;
+        }
+        wchar_t *text = realloc(lw->text, size * sizeof(*text));
+        if (!text)
+        {
+            return 0;
+        }
+        lw->text = text;
+        lw->size = size;
+    }
+
+    for (i = 0; i < sizeof(parts)/sizeof(parts[0]); i++)
+    {
+        if (part_len[i])
+        {
+            wmemcpy(lw->text + lw->len, parts[i], part_len[i]);
+            lw->len += part_len[i];
+        }
+    }
+    lw->text[lw->len++] = L'\n';
+    lw->text[lw->len] = L'\0';
+    return 1;
+}
+
+void
+log_writer_clear(log_writer_t *lw)
+{
+    lw->len = 0;
+    if (lw->text)
+    {
+        lw->text[0] = L'\0';
+    }
+}
+
+void
+log_writer_free(log_writer_t *lw)
+{
+    free(lw->text);
+    memset(lw, 0, sizeof(*lw));
+}
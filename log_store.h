@@ -0,0 +1,149 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <wchar.h>
+
+/*
+ * Recent log lines of a connection kept in a circular store: once full,
+ * adding a line evicts the oldest ones in constant time. Records are
+ * addressed by a sequence number that keeps increasing across evictions.
+ * This module has no Windows dependency.
+ */
+
+#define LOG_STORE_MAX_LINE 8192     /* longer lines are truncated */
+
+/* colour class of a log line */
+typedef enum {
+    log_class_normal,
+    log_class_warning,
+    log_class_error
+} log_class_t;
+
+/* text[offset]..text[offset+len-1] is the line including its newline */
+typedef struct {
+    time_t timestamp;
+    size_t offset;
+    size_t len;
+    log_class_t class;
+    int flags;
+} log_record_t;
+
+typedef struct {
+    log_record_t *rec;          /* ring of records */
+    size_t rec_cap;
+    size_t rec_head;            /* index of the oldest record */
+    size_t count;
+    unsigned long long first_seq; /* sequence number of the oldest record */
+    wchar_t *text;              /* ring of line text, one spare char at the end */
+    size_t text_size;
+    size_t text_head;           /* start of the oldest line */
+    size_t text_tail;           /* end of the newest line */
+    size_t reserved;            /* offset handed out by log_store_reserve() */
+    size_t max_lines;
+    size_t max_chars;
+} log_store_t;
+
+/*
+ * Set the number of lines to retain. Memory is allocated as lines
+ * come in and grows up to a limit derived from max_lines.
+ */
+void log_store_init(log_store_t *ls, size_t max_lines);
+
+/* release all memory, the store has to be initialized again for reuse */
+void log_store_free(log_store_t *ls);
+
+/*
+ * Split a management log line "<TIMESTAMP>,<FLAGS>,<MESSAGE>" and
+ * classify it by its flags. Returns 0 if the line is malformed.
+ */
+int log_parse_mgmt_line(const char *line, time_t *timestamp, log_class_t *class,
+                        const char **message);
+
+/* classify a line written by the GUI from its prefix */
+log_class_t log_classify_prefix(const wchar_t *prefix);
+
+/*
+ * Reserve room for a line of at most max_len characters (newline excluded,
+ * max_len <= LOG_STORE_MAX_LINE), evicting old lines as needed. Returns
+ * where to write the line or NULL on error. Complete it with log_store_commit().
+ */
+wchar_t *log_store_reserve(log_store_t *ls, size_t max_len);
+
+/*
+ * Add the len characters written at the reserved position as a new record.
+ * CR LF pairs in the line are reduced to LF so that each line break takes
+ * one character, as in a rich edit control.
+ */
+void log_store_commit(log_store_t *ls, size_t len, time_t timestamp,
+                      log_class_t class, int flags);
+
+/*
+ * Add a record made of the concatenation of the non-NULL parts, line
+ * breaks reduced as by log_store_commit(). Returns 0 if out of memory.
+ */
+int log_store_append(log_store_t *ls, time_t timestamp, log_class_t class, int flags,
+                     const wchar_t *datetime, const wchar_t *prefix, const wchar_t *message);
+
+/* sequence number the next record will get */
+static inline unsigned long long
+log_store_end(const log_store_t *ls)
+{
+    return ls->first_seq + ls->count;
+}
+
+/* the record with sequence number seq or NULL if evicted or not yet added */
+static inline const log_record_t *
+log_store_get(const log_store_t *ls, unsigned long long seq)
+{
+    if (seq < ls->first_seq || seq >= log_store_end(ls))
+    {
+        return NULL;
+    }
+    return &ls->rec[(ls->rec_head + (size_t) (seq - ls->first_seq)) % ls->rec_cap];
+}
+
+/*
+ * GUI lines waiting to be appended to the log file: adding one is a copy
+ * into this buffer and the caller writes the text out in one go.
+ */
+typedef struct {
+    wchar_t *text;              /* nul terminated */
+    size_t len;
+    size_t size;
+} log_writer_t;
+
+/*
+ * Add a line made of the concatenation of the non-NULL parts followed by
+ * a newline. Returns 0 if out of memory.
+ */
+int log_writer_append(log_writer_t *lw, const wchar_t *datetime, const wchar_t *prefix,
+                      const wchar_t *message);
+
+/* forget the buffered text after it has been written */
+void log_writer_clear(log_writer_t *lw);
+
+/* release all memory */
+void log_writer_free(log_writer_t *lw);
+
+#endif /* ifndef LOG_STORE_H */
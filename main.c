@@ -33,6 +33,7 @@
 #include <wtsapi32.h>
 #include <prsht.h>
 #include <commdlg.h>
+#include <stdlib.h>
 
 #include "tray.h"
 #include "openvpn.h"
@@ -403,6 +404,142 @@ StopAllOpenVPN(bool exiting)
 }
 
 
+/*
+ * Connections waiting to be started by AutoStartConnections() or
+ * ResumeConnections(). They are started one per START_QUEUE_INTERVAL
+ * while fewer than o.start_concurrency connections are coming up, or
+ * all at once if o.start_concurrency is 0, so
+ * that openvpn processes, scripts and the service pipe are not all
+ * hit at the same instant. Connections that waited for too long, e.g.,
+ * behind others waiting for a password, are started anyway.
+ */
+#define START_QUEUE_INTERVAL 100  /* msec */
+#define START_QUEUE_MAX_WAIT 30000 /* msec */
+#define IDT_START_QUEUE 2
+
+typedef struct {
+    connection_t *c;
+    conn_state_t state;     /* state the connection must still be in */
+    DWORD queued;           /* tick count when queued */
+} start_entry_t;
+
+static start_entry_t *start_queue;
+static int start_queue_len;
+static int start_queue_size;
+static int start_queue_head;
+
+static void CALLBACK RunStartQueue(HWND hwnd, UINT msg, UINT_PTR id, DWORD now);
+
+static void
+QueueStart(connection_t *c)
+{
+    if (start_queue_len == start_queue_size)
+    {
+        int size = start_queue_size ? 2*start_queue_size : 16;
+        start_entry_t *tmp = realloc(start_queue, size * sizeof(*tmp));
+        if (!tmp)
+        {
+            StartOpenVPN(c); /* no memory for queuing, start at once */
+            return;
+        }
+        start_queue = tmp;
+        start_queue_size = size;
+    }
+    start_queue[start_queue_len++] = (start_entry_t) {
+        .c = c, .state = c->state, .queued = GetTickCount()
+    };
+}
+
+/* persistent first, then the most recently connected, then in menu order */
+static int
+CompareStart(const void *a, const void *b)
+{
+    const connection_t *ca = ((const start_entry_t *) a)->c;
+    const connection_t *cb = ((const start_entry_t *) b)->c;
+    int pa = (ca->flags & FLAG_DAEMON_PERSISTENT) != 0;
+    int pb = (cb->flags & FLAG_DAEMON_PERSISTENT) != 0;
+
+    if (pa != pb)
+    {
+        return pb - pa;
+    }
+    if (ca->connected_since != cb->connected_since)
+    {
+        return (ca->connected_since > cb->connected_since) ? -1 : 1;
+    }
+    return ca->id - cb->id;
+}
+
+/* Order the queued connections and start the first ones */
+static void
+ScheduleStartQueue(void)
+{
+    if (start_queue_head < start_queue_len)
+    {
+        qsort(start_queue + start_queue_head, start_queue_len - start_queue_head,
+              sizeof(*start_queue), CompareStart);
+    }
+    RunStartQueue(o.hWnd, 0, IDT_START_QUEUE, 0);
+}
+
+static void
+ClearStartQueue(void)
+{
+    KillTimer(o.hWnd, IDT_START_QUEUE);
+    free(start_queue);
+    start_queue = NULL;
+    start_queue_len = start_queue_size = start_queue_head = 0;
+}
+
+static void CALLBACK
+RunStartQueue(HWND hwnd, UINT UNUSED msg, UINT_PTR UNUSED id, DWORD UNUSED now)
+{
+    int starting = CountConnState(connecting) + CountConnState(resuming)
+                   + CountConnState(reconnecting);
+
+    while (start_queue_head < start_queue_len)
+    {
+        if (o.start_concurrency && starting >= (int) o.start_concurrency
+            && GetTickCount() - start_queue[start_queue_head].queued < START_QUEUE_MAX_WAIT)
+        {
+            break;
+        }
+
+        start_entry_t *e = &start_queue[start_queue_head++];
+        /* skip connections started or changed in the meantime */
+        if (e->c->state != e->state)
+        {
+            continue;
+        }
+
+        /* logged by the status thread once its window exists */
+        e->c->from_queue = TRUE;
+        e->c->queue_wait = GetTickCount() - e->queued;
+        e->c->queue_starting = starting;
+        if (StartOpenVPN(e->c))
+        {
+            starting++;
+        }
+        else
+        {
+            e->c->from_queue = FALSE;
+        }
+        if (o.start_concurrency)
+        {
+            break; /* at most one per interval */
+        }
+    }
+
+    if (start_queue_head < start_queue_len)
+    {
+        SetTimer(hwnd, IDT_START_QUEUE, START_QUEUE_INTERVAL, RunStartQueue);
+    }
+    else
+    {
+        ClearStartQueue();
+    }
+}
+
 static int
 AutoStartConnections()
 {
@@ -410,9 +547,10 @@ AutoStartConnections()
     {
         if (c->auto_connect && !(c->flags & FLAG_DAEMON_PERSISTENT))
         {
-            StartOpenVPN(c);
+            QueueStart(c);
         }
     }
+    ScheduleStartQueue();
 
     return TRUE;
 }
@@ -426,7 +564,7 @@ ResumeConnections()
         /* Restart suspend connections */
         if (c->state == suspended)
         {
-            StartOpenVPN(c);
+            QueueStart(c);
         }
 
         /* If some connection never reached SUSPENDED state */
@@ -435,6 +573,7 @@ ResumeConnections()
             StopOpenVPN(c);
         }
     }
+    ScheduleStartQueue();
 }
 
 static int
@@ -475,6 +614,14 @@ HandleCopyDataMessage(const COPYDATASTRUCT *copy_data)
         ForceForegroundWindow(o.hWnd);
         ShowWindow(c->hwndStatus, SW_SHOW);
     }
+    else if (copy_data->dwData == WM_OVPN_THROUGHPUT && c && c->hwndStatus)
+    {
+        PostMessage(c->hwndStatus, WM_OVPN_THROUGHPUT, 0, 0);
+    }
+    else if (copy_data->dwData == WM_OVPN_LATENCY && c && c->hwndStatus)
+    {
+        PostMessage(c->hwndStatus, WM_OVPN_LATENCY, 0, 0);
+    }
     else if (copy_data->dwData == WM_OVPN_STOPALL)
     {
         StopAllOpenVPN(false);
@@ -516,16 +663,58 @@ HandleCopyDataMessage(const COPYDATASTRUCT *copy_data)
     return TRUE; /* indicate we handled the message */
 }
 
+/* Delays in msec for tending to persistent connections */
+#define PERSISTENT_POLL_INTERVAL  10000   /* if not notified of service changes */
+#define PERSISTENT_POLL_SLOW      300000  /* safety net if notified */
+#define PERSISTENT_ATTACH_DELAY   500     /* collects events into one pass */
+#define PERSISTENT_ATTACH_BATCH   4       /* max attaches started per pass */
+
+#define IDT_PERSISTENT 1
+
+static BOOL service_watched;        /* service state changes are notified */
+static BOOL persistent_scheduled;
+static DWORD persistent_due;        /* tick count of the scheduled check */
+
+static void CALLBACK ManagePersistent(HWND hwnd, UINT msg, UINT_PTR id, DWORD now);
+
+/* Schedule ManagePersistent() in delay msec unless it is due earlier */
+static void
+SchedulePersistent(HWND hwnd, DWORD delay)
+{
+    DWORD now = GetTickCount();
+
+    if (persistent_scheduled && (LONG) (persistent_due - now) <= (LONG) delay)
+    {
+        return;
+    }
+    persistent_scheduled = TRUE;
+    persistent_due = now + delay;
+    SetTimer(hwnd, IDT_PERSISTENT, delay, ManagePersistent);
+}
+
+static void
+CancelPersistent(HWND hwnd)
+{
+    KillTimer(hwnd, IDT_PERSISTENT);
+    persistent_scheduled = FALSE;
+}
+
 /* If automatic service is running, check whether we are
  * attached to the management i/f of persistent daemons
- * and re-attach if necessary. The timer is reset to
- * call this routine again after a delay. Periodic check
- * is required as we get detached if the daemon gets restarted
- * by the service or we do a disconnect.
+ * and re-attach if necessary. This runs shortly after the
+ * service changes state or a persistent connection gets
+ * detached (WM_OVPN_PERSISTENT), and attaches in batches
+ * to not start too many connections at once. A slow poll
+ * remains as a fallback, faster if the service cannot be
+ * watched.
  */
 static void CALLBACK
-ManagePersistent(HWND hwnd, UINT UNUSED msg, UINT_PTR id, DWORD UNUSED now)
+ManagePersistent(HWND hwnd, UINT UNUSED msg, UINT_PTR UNUSED id, DWORD UNUSED now)
 {
+    int started = 0;
+    BOOL pending = FALSE;
+
+    CancelPersistent(hwnd);
     CheckServiceStatus();
     if (o.service_state == service_connected)
     {
@@ -535,18 +724,31 @@ ManagePersistent(HWND hwnd, UINT UNUSED msg, UINT_PTR id, DWORD UNUSED now)
                 && c->auto_connect
                 && (c->state == disconnected || c->state == detached))
             {
+                if (started == PERSISTENT_ATTACH_BATCH)
+                {
+                    pending = TRUE;
+                    break;
+                }
                 /* disable auto-connect to avoid repeated re-connect
                  * after unrecoverable errors. Re-enabled on successful
                  * connect.
                  */
                 c->auto_connect = false;
-                c->state = detached; /* this is required to retain management-hold on re-attach */
+                SetConnState(c, detached); /* this is required to retain management-hold on re-attach */
                 StartOpenVPN(c); /* attach to the management i/f */
+                started++;
             }
         }
     }
-    /* schedule to call again after 10 sec */
-    SetTimer(hwnd, id, 10000, ManagePersistent);
+
+    if (pending)
+    {
+        SchedulePersistent(hwnd, PERSISTENT_ATTACH_DELAY);
+    }
+    else
+    {
+        SchedulePersistent(hwnd, service_watched ? PERSISTENT_POLL_SLOW : PERSISTENT_POLL_INTERVAL);
+    }
 }
 
 /* Detach from the mgmt i/f of all atatched persistent
@@ -637,9 +839,21 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
                 SendMessage(hwnd, WM_CLOSE, 0, 0);
                 break;
             }
-            /* A timer to periodically tend to persistent connections */
-            SetTimer(hwnd, 1, 100, ManagePersistent);
+            /* Tend to persistent connections on service changes and periodically */
+            service_watched = WatchServiceStatus(hwnd);
+            SchedulePersistent(hwnd, 100);
+
+            break;
 
+        case WM_OVPN_PERSISTENT: /* service state changed or a persistent connection detached */
+            if (wParam)
+            {
+                service_watched = FALSE;
+            }
+            if (!o.session_locked)
+            {
+                SchedulePersistent(hwnd, PERSISTENT_ATTACH_DELAY);
+            }
             break;
 
         case WM_NOTIFYICONTRAY:
@@ -650,6 +864,10 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
             HandleCopyDataMessage((COPYDATASTRUCT *) lParam);
             return TRUE; /* lets the sender free copy_data */
 
+        case WM_INITMENUPOPUP:
+            OnInitMenuPopup((HMENU) wParam);
+            break;
+
         case WM_MENUCOMMAND:
             /* Get the menu item id and save it in wParam for use below */
             wParam = GetMenuItemID((HMENU) lParam, wParam);
@@ -725,6 +943,7 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 
         case WM_DESTROY:
             WTSUnRegisterSessionNotification(hwnd);
+            ClearStartQueue();
             StopAllOpenVPN(true);
             OnDestroyTray();    /* Remove Tray Icon and destroy menus */
             PostQuitMessage(0); /* Send a WM_QUIT to the message queue */
@@ -735,6 +954,7 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 
         case WM_ENDSESSION:
             SaveAutoRestartList();
+            ClearStartQueue();
             StopAllOpenVPN(true);
             OnDestroyTray();
             break;
@@ -747,14 +967,14 @@ WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
                     o.session_locked = TRUE;
                     /* Detach persistent connections so that other users can connect to it */
                     HandleSessionLock();
-                    KillTimer(hwnd, 1); /* This ensure ManagePersistent is not called when session is locked */
+                    CancelPersistent(hwnd); /* This ensure ManagePersistent is not called when session is locked */
                     break;
 
                 case WTS_SESSION_UNLOCK:
                     PrintDebug(L"Session unlock triggered");
                     o.session_locked = FALSE;
                     HandleSessionUnlock();
-                    SetTimer(hwnd, 1, 100, ManagePersistent);
+                    SchedulePersistent(hwnd, 100);
                     if (CountConnState(suspended) != 0)
                     {
                         ResumeConnections();
@@ -37,7 +37,11 @@
 #define MAX_LOG_LENGTH      1024/* Max number of characters per log line */
 #define MAX_LOG_LINES           500     /* Max number of lines in LogWindow */
 #define DEL_LOG_LINES           10      /* Number of lines to delete from LogWindow */
-#define USAGE_BUF_SIZE          3000    /* Size of buffer used to display usage message */
+#define LOG_FLUSH_INTERVAL      100     /* Max delay in msec before new lines show in LogWindow */
+#define LOG_FILE_FLUSH_SIZE     16384   /* Buffered characters that trigger a write to the log file */
+#define USAGE_BUF_SIZE          4096    /* Size of buffer used to display usage message */
+#define BYTECOUNT_INTERVAL_SHOWN  5     /* Seconds between bytecount reports while the status window is shown */
+#define BYTECOUNT_INTERVAL_HIDDEN 60    /* and while it is hidden */
 
 /* Authorized group who can use any options and config locations */
 #define OVPN_ADMIN_GROUP TEXT("OpenVPN Administrators") /* May be reset in registry */
@@ -61,6 +65,10 @@
 #define WM_OVPN_ECHOMSG        (WM_APP + 22)
 #define WM_OVPN_STATE          (WM_APP + 23)
 #define WM_OVPN_DETACH         (WM_APP + 24)
+#define WM_OVPN_LOG            (WM_APP + 25)
+#define WM_OVPN_THROUGHPUT     (WM_APP + 26)
+#define WM_OVPN_LATENCY        (WM_APP + 27)
+#define WM_OVPN_PERSISTENT     (WM_APP + 28)
 
 #define MSGF_OVPN_WAIT         (MSGF_USER + 1)
 
@@ -85,6 +93,13 @@ struct security_attributes
     SECURITY_DESCRIPTOR sd;
 };
 
+/* storage class of variables with one instance per thread */
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 /* clear an object */
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
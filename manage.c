@@ -31,6 +31,7 @@
 #include "manage.h"
 #include "main.h"
 #include "misc.h"
+#include "openvpn-gui-res.h"
 
 extern options_t o;
 
@@ -41,6 +42,124 @@ static mgmt_msg_func rtmsg_handler[mgmt_rtmsg_type_max];
  */
 static const time_t max_connect_time = 15;
 
+/*
+ * Range of the delay in ms before reconnecting to the management
+ * interface after a failed attempt
+ */
+#define MGMT_RETRY_MIN 50
+#define MGMT_RETRY_MAX 5000
+
+/* Time in ms to wait for the answer to the command sent on >INFO */
+#define MGMT_READY_TIMEOUT 2000
+
+/*
+ * Initial size of the management read buffer. It grows if a single
+ * read or an incomplete line does not fit.
+ */
+#define MGMT_RBUF_SIZE 4096
+
+/*
+ * Max number of unused command queue nodes to keep per connection
+ */
+#define MGMT_CMD_FREE_MAX 16
+
+/*
+ * Prefixes of real-time notifications sorted by their first letter.
+ * The index of each entry is used in mgmt_rtmsg_classify().
+ */
+typedef struct {
+    const char *name;
+    size_t len;
+    mgmt_rtmsg_type type;
+} rtmsg_prefix_t;
+
+#define RTMSG_PREFIX(name, type) { name, sizeof(name) - 1, type }
+
+static const rtmsg_prefix_t rtmsg_prefix[] = {
+    RTMSG_PREFIX("BYTECOUNT:", bytecount_),      /* 0 */
+    RTMSG_PREFIX("ECHO:", echo_),                /* 1 */
+    RTMSG_PREFIX("HOLD:", hold_),                /* 2 */
+    RTMSG_PREFIX("INFO:", ready_),               /* 3 */
+    RTMSG_PREFIX("INFOMSG:", infomsg_),          /* 4 */
+    RTMSG_PREFIX("LOG:", log_),                  /* 5 */
+    RTMSG_PREFIX("NEED-OK:", needok_),           /* 6 */
+    RTMSG_PREFIX("NEED-STR:", needstr_),         /* 7 */
+    RTMSG_PREFIX("PASSWORD:", password_),        /* 8 */
+    RTMSG_PREFIX("PKCS11ID", pkcs11_id_count_),  /* 9 */
+    RTMSG_PREFIX("PROXY:", proxy_),              /* 10 */
+    RTMSG_PREFIX("STATE:", state_),              /* 11 */
+};
+
+/*
+ * Find the type of a real-time notification from its prefix. The
+ * first letter selects the candidates so that at most three prefixes
+ * are compared. On success the length of the matched prefix is
+ * returned in len, else mgmt_rtmsg_type_max is returned.
+ */
+mgmt_rtmsg_type
+mgmt_rtmsg_classify(const char *msg, size_t *len)
+{
+    int first, count;
+
+    switch (msg[0])
+    {
+        case 'B':
+            first = 0;
+            count = 1;
+            break;
+
+        case 'E':
+            first = 1;
+            count = 1;
+            break;
+
+        case 'H':
+            first = 2;
+            count = 1;
+            break;
+
+        case 'I':
+            first = 3;
+            count = 2;
+            break;
+
+        case 'L':
+            first = 5;
+            count = 1;
+            break;
+
+        case 'N':
+            first = 6;
+            count = 2;
+            break;
+
+        case 'P':
+            first = 8;
+            count = 3;
+            break;
+
+        case 'S':
+            first = 11;
+            count = 1;
+            break;
+
+        default:
+            return mgmt_rtmsg_type_max;
+    }
+
+    for (int i = first; i < first + count; i++)
+    {
+        const rtmsg_prefix_t *p = &rtmsg_prefix[i];
+        if (strncmp(msg, p->name, p->len) == 0)
+        {
+            *len = p->len;
+            return p->type;
+        }
+    }
+
+    return mgmt_rtmsg_type_max;
+}
+
 /*
  * Initialize the real-time notification handlers
  */
@@ -68,7 +187,8 @@ OpenManagement(connection_t *c)
     }
 
     c->manage.connected = 0;
-    c->manage.sk = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int family = c->manage.skaddr.ss_family;
+    c->manage.sk = socket(family, SOCK_STREAM, IPPROTO_TCP);
     if (c->manage.sk == INVALID_SOCKET)
     {
         WSACleanup();
@@ -80,38 +200,121 @@ OpenManagement(connection_t *c)
         return FALSE;
     }
 
-    connect(c->manage.sk, (SOCKADDR *)&c->manage.skaddr, sizeof(c->manage.skaddr));
+    connect(c->manage.sk, (SOCKADDR *)&c->manage.skaddr, c->manage.skaddr_len);
     c->manage.timeout = time(NULL) + max_connect_time;
+    c->manage.retries = 0;
+    c->manage.retry_delay = 0;
+    c->manage.probe_lost = FALSE;
 
     return TRUE;
 }
 
 
 /*
- * Try to send a queued management command to OpenVPN
+ * Try to send queued management commands to OpenVPN. Up to
+ * o.mgmt_pipeline commands are written before the response to
+ * the first one arrives, but none past a barrier command that is
+ * not yet answered. Responses are matched to commands in the order
+ * they were queued.
  */
 static void
 SendCommand(connection_t *c)
 {
     int res;
+    DWORD max = o.mgmt_pipeline ? o.mgmt_pipeline : 1;
     mgmt_cmd_t *cmd = c->manage.cmd_queue;
-    if (cmd == NULL || cmd->size == 0)
+
+    for (DWORD i = 0; cmd && i < max; i++)
     {
-        return;
+        if (cmd->sent < cmd->size)
+        {
+            res = send(c->manage.sk, cmd->command + cmd->sent, cmd->size - cmd->sent, 0);
+            if (res < 1)
+            {
+                return;
+            }
+
+            cmd->sent += res;
+            if (cmd->sent < cmd->size)
+            {
+                return; /* continue on FD_WRITE */
+            }
+        }
+
+        if (cmd->barrier)
+        {
+            break;
+        }
+
+        cmd = cmd->next;
+        if (cmd == c->manage.cmd_queue)
+        {
+            break;
+        }
+    }
+}
+
+
+/*
+ * Get a command queue node with room for a command of the given size,
+ * reusing a previously released node if possible.
+ */
+static mgmt_cmd_t *
+AllocCommand(connection_t *c, int size)
+{
+    mgmt_cmd_t *cmd = c->manage.cmd_free;
+    if (cmd)
+    {
+        c->manage.cmd_free = cmd->next;
+        c->manage.cmd_free_count--;
+        CLEAR(*cmd);
+    }
+    else
+    {
+        cmd = calloc(1, sizeof(*cmd));
+        if (cmd == NULL)
+        {
+            return NULL;
+        }
     }
 
-    res = send(c->manage.sk, cmd->command, cmd->size, 0);
-    if (res < 1)
+    cmd->command = cmd->buf;
+    if (size > (int) sizeof(cmd->buf))
     {
-        return;
+        cmd->command = malloc(size);
+        if (cmd->command == NULL)
+        {
+            free(cmd);
+            return NULL;
+        }
     }
+    cmd->size = size;
+
+    return cmd;
+}
+
 
-    if (res != cmd->size)
+/*
+ * Release a command queue node. The command must have been wiped.
+ */
+static void
+FreeCommand(connection_t *c, mgmt_cmd_t *cmd)
+{
+    if (cmd->command != cmd->buf)
     {
-        memmove(cmd->command, cmd->command + res, cmd->size - res);
+        free(cmd->command);
     }
 
-    cmd->size -= res;
+    if (c->manage.cmd_free_count < MGMT_CMD_FREE_MAX)
+    {
+        cmd->next = c->manage.cmd_free;
+        c->manage.cmd_free = cmd;
+        c->manage.cmd_free_count++;
+    }
+    else
+    {
+        free(cmd);
+    }
 }
 
 
@@ -121,21 +324,15 @@ SendCommand(connection_t *c)
 BOOL
 ManagementCommand(connection_t *c, char *command, mgmt_msg_func handler, mgmt_cmd_type type)
 {
-    mgmt_cmd_t *cmd = calloc(1, sizeof(*cmd));
+    int size = strlen(command) + 1;
+    mgmt_cmd_t *cmd = AllocCommand(c, size);
     if (cmd == NULL)
     {
         return FALSE;
     }
 
-    cmd->size = strlen(command) + 1;
-    cmd->command = malloc(cmd->size);
-    if (cmd->command == NULL)
-    {
-        free(cmd);
-        return FALSE;
-    }
-    memcpy(cmd->command, command, cmd->size);
-    *(cmd->command + cmd->size - 1) = '\n';
+    memcpy(cmd->command, command, size);
+    cmd->command[size - 1] = '\n';
 
     cmd->handler = handler;
     cmd->type = type;
@@ -152,10 +349,7 @@ ManagementCommand(connection_t *c, char *command, mgmt_msg_func handler, mgmt_cm
         c->manage.cmd_queue = cmd;
     }
 
-    if (c->manage.cmd_queue == cmd)
-    {
-        SendCommand(c);
-    }
+    SendCommand(c);
 
     return TRUE;
 }
@@ -174,7 +368,7 @@ UnqueueCommand(connection_t *c)
     }
 
     /* Wipe command as it may contain passwords */
-    memset(cmd->command, 'x', cmd->size);
+    SecureZeroMemory(cmd->command, cmd->size);
 
     if (cmd->type == combined)
     {
@@ -194,25 +388,189 @@ UnqueueCommand(connection_t *c)
         SendCommand(c);
     }
 
-    free(cmd->command);
-    free(cmd);
+    FreeCommand(c, cmd);
 
     return TRUE;
 }
 
 
+/*
+ * Make room for at least size more bytes in the read buffer
+ */
+static BOOL
+ReserveReadBuffer(mgmt_rbuf_t *rb, size_t size)
+{
+    if (rb->size - rb->len >= size)
+    {
+        return TRUE;
+    }
+
+    size_t new_size = rb->size ? rb->size : MGMT_RBUF_SIZE;
+    while (new_size - rb->len < size)
+    {
+        new_size *= 2;
+    }
+
+    char *tmp = realloc(rb->data, new_size);
+    if (tmp == NULL)
+    {
+        return FALSE;
+    }
+    rb->data = tmp;
+    rb->size = new_size;
+
+    return TRUE;
+}
+
+/*
+ * Give the read buffer back to the connection after its lines have been
+ * dispatched, keeping the unprocessed bytes from offset onwards.
+ */
+static void
+ReturnReadBuffer(connection_t *c, SOCKET sk, mgmt_rbuf_t *rb, size_t offset)
+{
+    size_t tail = rb->len - offset;
+
+    /* management got closed while dispatching */
+    if (c->manage.sk != sk)
+    {
+        free(rb->data);
+        return;
+    }
+
+    if (c->manage.rbuf.data == NULL)
+    {
+        memmove(rb->data, rb->data + offset, tail);
+        rb->len = tail;
+        c->manage.rbuf = *rb;
+        return;
+    }
+
+    /* A handler entered a modal loop which read more data: that goes after our tail */
+    if (tail && ReserveReadBuffer(&c->manage.rbuf, tail))
+    {
+        mgmt_rbuf_t *cur = &c->manage.rbuf;
+        memmove(cur->data + tail, cur->data, cur->len);
+        memcpy(cur->data, rb->data + offset, tail);
+        cur->len += tail;
+    }
+    free(rb->data);
+}
+
+
+/*
+ * Schedule another connect attempt after a failed one. The delay doubles
+ * with every failure up to MGMT_RETRY_MAX and a random part of up to half
+ * of it is dropped, so that daemons restarting together are not all
+ * polled at once.
+ */
+static void
+ScheduleManagementRetry(connection_t *c)
+{
+    DWORD delay = c->manage.retry_delay;
+    unsigned int r = (GetTickCount() ^ ((unsigned int) c->id * 2654435761u)) * 2654435761u;
+
+    delay = delay ? min(2*delay, MGMT_RETRY_MAX) : MGMT_RETRY_MIN;
+    c->manage.retry_delay = delay;
+    if (c->manage.retries++ == 0)
+    {
+        c->manage.retry_start = GetTickCount();
+    }
+
+    delay -= (r >> 8) % (delay/2 + 1);
+    if (!SetTimer(c->hwndStatus, IDT_CONNECT_TIMER, delay, NULL))
+    {
+        connect(c->manage.sk, (SOCKADDR *)&c->manage.skaddr, c->manage.skaddr_len);
+    }
+}
+
+void
+RetryManagement(connection_t *c)
+{
+    KillTimer(c->hwndStatus, IDT_CONNECT_TIMER);
+    if (c->manage.sk != INVALID_SOCKET && !c->manage.connected)
+    {
+        connect(c->manage.sk, (SOCKADDR *)&c->manage.skaddr, c->manage.skaddr_len);
+    }
+}
+
+
+/*
+ * The response to the command sent on >INFO: the management interface
+ * is processing input.
+ */
+static void
+OnReadyResponse(connection_t *c, UNUSED char *msg)
+{
+    KillTimer(c->hwndStatus, IDT_READY_TIMER);
+    if (rtmsg_handler[log_])
+    {
+        char buf[256];
+        _snprintf_0(buf, "%lld,I,Management interface answered %lu ms after it was ready",
+                    (long long)time(NULL), GetTickCount() - c->manage.ready_start)
+        rtmsg_handler[log_](c, buf);
+    }
+}
+
+
+void
+OnReadyTimeout(connection_t *c)
+{
+    mgmt_cmd_t *cmd = c->manage.cmd_queue;
+
+    KillTimer(c->hwndStatus, IDT_READY_TIMER);
+    if (c->manage.sk == INVALID_SOCKET)
+    {
+        return;
+    }
+
+    if (!cmd)
+    {
+        return;
+    }
+    if (cmd->handler != OnReadyResponse)
+    {
+        /* still behind earlier commands: give it another period */
+        do
+        {
+            cmd = cmd->next;
+            if (cmd->handler == OnReadyResponse)
+            {
+                SetTimer(c->hwndStatus, IDT_READY_TIMER, MGMT_READY_TIMEOUT, NULL);
+                return;
+            }
+        } while (cmd != c->manage.cmd_queue);
+        return;
+    }
+
+    /* Input written too early may have been dropped: forget the command
+     * and release the commands behind it. A late answer is ignored.
+     */
+    if (rtmsg_handler[log_])
+    {
+        char buf[256];
+        _snprintf_0(buf, "%lld,W,Management interface did not answer within %d ms, continuing",
+                    (long long)time(NULL), MGMT_READY_TIMEOUT)
+        rtmsg_handler[log_](c, buf);
+    }
+    c->manage.probe_lost = TRUE;
+    UnqueueCommand(c);
+}
+
+
 /*
  * Handle management socket events asynchronously
  */
 void
-OnManagement(SOCKET sk, LPARAM lParam)
+OnManagement(connection_t *c, SOCKET sk, LPARAM lParam)
 {
     int res;
     char *data;
     ULONG data_size, offset;
+    mgmt_rbuf_t rbuf;
 
-    connection_t *c = GetConnByManagement(sk);
-    if (c == NULL)
+    /* ignore events still queued for a socket that has been closed */
+    if (c == NULL || c->manage.sk != sk)
     {
         return;
     }
@@ -226,8 +584,9 @@ OnManagement(SOCKET sk, LPARAM lParam)
                 if (c->flags & FLAG_DAEMON_PERSISTENT
                     || time(NULL) < c->manage.timeout)
                 {
-                    /* show a message on status window */
-                    if (rtmsg_handler[log_] && (c->flags & FLAG_DAEMON_PERSISTENT))
+                    /* show a message on status window, once per wait */
+                    if (rtmsg_handler[log_] && (c->flags & FLAG_DAEMON_PERSISTENT)
+                        && c->manage.retries == 0)
                     {
                         char buf[256];
                         _snprintf_0(buf, "%lld,W,Waiting for the management interface to come up",
@@ -235,7 +594,7 @@ OnManagement(SOCKET sk, LPARAM lParam)
                         rtmsg_handler[log_](c, buf);
                     }
 
-                    connect(c->manage.sk, (SOCKADDR *)&c->manage.skaddr, sizeof(c->manage.skaddr));
+                    ScheduleManagementRetry(c);
                 }
                 else
                 {
@@ -250,6 +609,21 @@ OnManagement(SOCKET sk, LPARAM lParam)
             else
             {
                 c->manage.connected = 1;
+                if (c->manage.retries)
+                {
+                    DWORD elapsed = GetTickCount() - c->manage.retry_start;
+                    c->manage.retries_total += c->manage.retries;
+                    PrintDebug(L"Management interface of %ls up after %d retries in %lu ms "
+                               L"(%lu retries in total)", c->config_name, c->manage.retries,
+                               elapsed, c->manage.retries_total);
+                    if (rtmsg_handler[log_] && (c->flags & FLAG_DAEMON_PERSISTENT))
+                    {
+                        char buf[256];
+                        _snprintf_0(buf, "%lld,I,Management interface came up after %d retries in %lu ms",
+                                    (long long)time(NULL), c->manage.retries, elapsed)
+                        rtmsg_handler[log_](c, buf);
+                    }
+                }
             }
             break;
 
@@ -260,28 +634,25 @@ OnManagement(SOCKET sk, LPARAM lParam)
                 return;
             }
 
-            data = malloc(c->manage.saved_size + data_size);
-            if (data == NULL)
+            if (!ReserveReadBuffer(&c->manage.rbuf, data_size))
             {
                 return;
             }
 
-            res = recv(c->manage.sk, data + c->manage.saved_size, data_size, 0);
-            if (res != (int) data_size)
+            res = recv(c->manage.sk, c->manage.rbuf.data + c->manage.rbuf.len, data_size, 0);
+            if (res < 1)
             {
-                free(data);
                 return;
             }
+            c->manage.rbuf.len += res;
 
-            /* Copy previously saved management data */
-            if (c->manage.saved_size)
-            {
-                memcpy(data, c->manage.saved_data, c->manage.saved_size);
-                data_size += c->manage.saved_size;
-                free(c->manage.saved_data);
-                c->manage.saved_data = NULL;
-                c->manage.saved_size = 0;
-            }
+            /* Detach the buffer while its lines are dispatched: handlers may close
+             * the management connection or read more data from a modal dialog loop.
+             */
+            rbuf = c->manage.rbuf;
+            CLEAR(c->manage.rbuf);
+            data = rbuf.data;
+            data_size = rbuf.len;
 
             offset = 0;
             while (offset < data_size)
@@ -305,32 +676,27 @@ OnManagement(SOCKET sk, LPARAM lParam)
 
                 if (pos == NULL)
                 {
-                    c->manage.saved_data = malloc(line_size);
-                    if (c->manage.saved_data)
-                    {
-                        c->manage.saved_size = line_size;
-                        memcpy(c->manage.saved_data, line, c->manage.saved_size);
-                    }
+                    /* incomplete line -- wait for more data */
                     break;
                 }
 
                 offset += (pos - line) + 1;
 
                 /* Reply to a management password request */
-                if (*c->manage.password && passwd_request)
+                if (c->manage.password && *c->manage.password && passwd_request)
                 {
                     ManagementCommand(c, c->manage.password, NULL, regular);
-                    SecureZeroMemory(c->manage.password, sizeof(c->manage.password));
+                    SecureZeroMemory(c->manage.password, MGMT_PASSWORD_SIZE);
 
                     continue;
                 }
 
-                if (!*c->manage.password && passwd_request)
+                if ((!c->manage.password || !*c->manage.password) && passwd_request)
                 {
                     /* either we don't have a password or we used it and didn't match */
                     MsgToEventLog(EVENTLOG_WARNING_TYPE, L"%ls: management password mismatch",
                                   c->config_name);
-                    c->state = disconnecting;
+                    SetConnState(c, disconnecting);
                     CloseManagement(c);
                     rtmsg_handler[stop_](c, "");
 
@@ -342,101 +708,53 @@ OnManagement(SOCKET sk, LPARAM lParam)
                 if (line[0] == '>')
                 {
                     /* Real time notifications */
+                    size_t prefix_len;
+                    mgmt_rtmsg_type type;
+
                     pos = line + 1;
-                    if (strncmp(pos, "LOG:", 4) == 0)
-                    {
-                        if (rtmsg_handler[log_])
-                        {
-                            rtmsg_handler[log_](c, pos + 4);
-                        }
-                    }
-                    else if (strncmp(pos, "STATE:", 6) == 0)
-                    {
-                        if (rtmsg_handler[state_])
-                        {
-                            rtmsg_handler[state_](c, pos + 6);
-                        }
-                    }
-                    else if (strncmp(pos, "HOLD:", 5) == 0)
-                    {
-                        if (rtmsg_handler[hold_])
-                        {
-                            rtmsg_handler[hold_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "PASSWORD:", 9) == 0)
+                    type = mgmt_rtmsg_classify(pos, &prefix_len);
+                    if (type == ready_)
                     {
-                        if (rtmsg_handler[password_])
-                        {
-                            rtmsg_handler[password_](c, pos + 9);
-                        }
-                    }
-                    else if (strncmp(pos, "PROXY:", 6) == 0)
-                    {
-                        if (rtmsg_handler[proxy_])
+                        /* Queue a no-op command as a barrier ahead of all others:
+                         * commands queued by the handler are only sent once it is
+                         * answered, whatever the pipeline depth.
+                         */
+                        c->manage.ready_start = GetTickCount();
+                        if (ManagementCommand(c, "pid", OnReadyResponse, regular))
                         {
-                            rtmsg_handler[proxy_](c, pos + 6);
+                            c->manage.cmd_queue->prev->barrier = TRUE;
+                            SetTimer(c->hwndStatus, IDT_READY_TIMER, MGMT_READY_TIMEOUT, NULL);
                         }
-                    }
-                    else if (strncmp(pos, "INFO:", 5) == 0)
-                    {
-                        /* delay until management interface accepts input */
-                        /* use real sleep here, since WM_MANAGEMENT might arrive before management is ready */
-                        Sleep(100);
                         c->manage.connected = 2;
                         if (rtmsg_handler[ready_])
                         {
-                            rtmsg_handler[ready_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "NEED-OK:", 8) == 0)
-                    {
-                        if (rtmsg_handler[needok_])
-                        {
-                            rtmsg_handler[needok_](c, pos + 8);
-                        }
-                    }
-                    else if (strncmp(pos, "NEED-STR:", 9) == 0)
-                    {
-                        if (rtmsg_handler[needstr_])
-                        {
-                            rtmsg_handler[needstr_](c, pos + 9);
+                            rtmsg_handler[ready_](c, pos + prefix_len);
                         }
                     }
-                    else if (strncmp(pos, "ECHO:", 5) == 0)
-                    {
-                        if (rtmsg_handler[echo_])
-                        {
-                            rtmsg_handler[echo_](c, pos + 5);
-                        }
-                    }
-                    else if (strncmp(pos, "BYTECOUNT:", 10) == 0)
-                    {
-                        if (rtmsg_handler[bytecount_])
-                        {
-                            rtmsg_handler[bytecount_](c, pos + 10);
-                        }
-                    }
-                    else if (strncmp(pos, "INFOMSG:", 8) == 0)
-                    {
-                        if (rtmsg_handler[infomsg_])
-                        {
-                            rtmsg_handler[infomsg_](c, pos + 8);
-                        }
-                    }
-                    else if (strncmp(pos, "PKCS11ID", 8) == 0
-                             && c->manage.cmd_queue)
+                    else if (type == pkcs11_id_count_)
                     {
                         /* This is not a real-time message, but unfortunately implemented
                          * in the core as one. Work around by handling the response here.
                          */
                         mgmt_cmd_t *cmd = c->manage.cmd_queue;
-                        if (cmd->handler)
+                        if (cmd)
                         {
-                            cmd->handler(c, line);
+                            if (cmd->handler)
+                            {
+                                cmd->handler(c, line);
+                            }
+                            UnqueueCommand(c);
                         }
-                        UnqueueCommand(c);
                     }
+                    else if (type != mgmt_rtmsg_type_max && rtmsg_handler[type])
+                    {
+                        rtmsg_handler[type](c, pos + prefix_len);
+                    }
+                }
+                else if (c->manage.probe_lost && strncmp(line, "SUCCESS: pid=", 13) == 0)
+                {
+                    /* late answer to the command given up by OnReadyTimeout() */
+                    c->manage.probe_lost = FALSE;
                 }
                 else if (c->manage.cmd_queue)
                 {
@@ -474,7 +792,7 @@ OnManagement(SOCKET sk, LPARAM lParam)
                     }
                 }
             }
-            free(data);
+            ReturnReadBuffer(c, sk, &rbuf, offset);
             break;
 
         case FD_WRITE:
@@ -496,18 +814,44 @@ CloseManagement(connection_t *c)
 {
     if (c->manage.sk != INVALID_SOCKET)
     {
-        if (c->manage.saved_size)
-        {
-            free(c->manage.saved_data);
-            c->manage.saved_data = NULL;
-            c->manage.saved_size = 0;
-        }
+        KillTimer(c->hwndStatus, IDT_CONNECT_TIMER);
+        KillTimer(c->hwndStatus, IDT_READY_TIMER);
+        free(c->manage.rbuf.data);
+        CLEAR(c->manage.rbuf);
         closesocket(c->manage.sk);
         c->manage.sk = INVALID_SOCKET;
         c->manage.connected = 0;
         while (UnqueueCommand(c))
         {
         }
+        while (c->manage.cmd_free)
+        {
+            mgmt_cmd_t *cmd = c->manage.cmd_free;
+            c->manage.cmd_free = cmd->next;
+            free(cmd);
+        }
+        c->manage.cmd_free_count = 0;
         WSACleanup();
     }
 }
+
+char *
+GetManagementPassword(connection_t *c)
+{
+    if (!c->manage.password)
+    {
+        c->manage.password = calloc(1, MGMT_PASSWORD_SIZE);
+    }
+    return c->manage.password;
+}
+
+void
+FreeManagementPassword(connection_t *c)
+{
+    if (c->manage.password)
+    {
+        SecureZeroMemory(c->manage.password, MGMT_PASSWORD_SIZE);
+        free(c->manage.password);
+        c->manage.password = NULL;
+    }
+}
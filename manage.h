@@ -54,23 +54,64 @@ typedef struct {
     mgmt_msg_func handler;
 } mgmt_rtmsg_handler;
 
+/* Data received from the management interface. Complete lines are
+ * handed to the message handlers in place, a trailing partial line
+ * stays in the buffer until the rest of it arrives.
+ */
+typedef struct {
+    char *data;
+    size_t size;                /* allocated size of data */
+    size_t len;                 /* number of bytes in data */
+} mgmt_rbuf_t;
+
+/* Size of the management password buffer -- match with largest possible passwd in openvpn.exe */
+#define MGMT_PASSWORD_SIZE 4096
+
+/* Commands up to this size (including the newline) are stored in the queue node */
+#define MGMT_CMD_INLINE_SIZE 64
+
 typedef struct mgmt_cmd {
     struct mgmt_cmd *prev, *next;
-    char *command;
+    char *command;              /* points to buf or to an allocated string */
     int size;
+    int sent;                   /* number of bytes already sent */
     mgmt_msg_func handler;
     mgmt_cmd_type type;
+    BOOL barrier;               /* later commands are not sent until this one is answered */
+    char buf[MGMT_CMD_INLINE_SIZE];
 } mgmt_cmd_t;
 
 
+/*
+ * Return the type of a real-time notification given the text following
+ * the leading '>' and set *len to the length of its prefix (e.g. "LOG:").
+ * Returns mgmt_rtmsg_type_max for unknown notifications.
+ */
+mgmt_rtmsg_type mgmt_rtmsg_classify(const char *msg, size_t *len);
+
 void InitManagement(const mgmt_rtmsg_handler *handler);
 
 BOOL OpenManagement(connection_t *);
 
 BOOL ManagementCommand(connection_t *, char *, mgmt_msg_func, mgmt_cmd_type);
 
-void OnManagement(SOCKET, LPARAM);
+void OnManagement(connection_t *, SOCKET, LPARAM);
+
+/* Make the connect attempt scheduled after a failed one, on IDT_CONNECT_TIMER */
+void RetryManagement(connection_t *);
+
+/* Give up waiting for the answer to the command sent on >INFO, on IDT_READY_TIMER */
+void OnReadyTimeout(connection_t *);
 
 void CloseManagement(connection_t *);
 
+/*
+ * Return the management password buffer of MGMT_PASSWORD_SIZE bytes,
+ * allocating it on first use, or NULL if out of memory.
+ */
+char *GetManagementPassword(connection_t *);
+
+/* Wipe and release the management password buffer */
+void FreeManagementPassword(connection_t *);
+
 #endif /* ifndef MANAGE_H */
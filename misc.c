@@ -862,6 +862,56 @@ out:
     return ret;
 }
 
+int
+ParseManagementEndpoint(const wchar_t *host, const wchar_t *port, SOCKADDR_STORAGE *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    u_short port_n = htons(_wtoi(port));
+    if (port_n == 0)
+    {
+        return 0;
+    }
+
+    SOCKADDR_IN *in = (SOCKADDR_IN *) addr;
+    if (InetPtonW(AF_INET, host, &in->sin_addr) == 1)
+    {
+        in->sin_family = AF_INET;
+        in->sin_port = port_n;
+        return sizeof(*in);
+    }
+
+    SOCKADDR_IN6 *in6 = (SOCKADDR_IN6 *) addr;
+    if (InetPtonW(AF_INET6, host, &in6->sin6_addr) == 1)
+    {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = port_n;
+        return sizeof(*in6);
+    }
+
+    return 0;
+}
+
+void
+FormatManagementEndpoint(const SOCKADDR_STORAGE *addr, wchar_t *buf, size_t len)
+{
+    wchar_t host[INET6_ADDRSTRLEN] = L"";
+
+    if (addr->ss_family == AF_INET6)
+    {
+        const SOCKADDR_IN6 *in6 = (const SOCKADDR_IN6 *) addr;
+        InetNtopW(AF_INET6, &in6->sin6_addr, host, _countof(host));
+        swprintf(buf, len, L"%ls %hu", host, ntohs(in6->sin6_port));
+    }
+    else
+    {
+        const SOCKADDR_IN *in = (const SOCKADDR_IN *) addr;
+        InetNtopW(AF_INET, &in->sin_addr, host, _countof(host));
+        swprintf(buf, len, L"%ls %hu", host, ntohs(in->sin_port));
+    }
+    buf[len - 1] = L'\0';
+}
+
 /* Parse the management address and password
  * from a config file. Results are returned
  * in c->manage.skaddr and c->magage.password.
@@ -873,7 +923,7 @@ ParseManagementAddress(connection_t *c)
 {
     BOOL ret = true;
     wchar_t *pw_file = NULL;
-    wchar_t *workdir = c->config_dir;
+    const wchar_t *workdir = c->config_dir;
     wchar_t config_path[MAX_PATH];
     wchar_t pw_path[MAX_PATH] = L"";
 
@@ -887,21 +937,15 @@ ParseManagementAddress(connection_t *c)
         return false;
     }
 
-    SOCKADDR_IN *addr = &c->manage.skaddr;
-    addr->sin_port = 0;
+    const wchar_t *mgmt_host = NULL;
+    const wchar_t *mgmt_port = NULL;
 
     while (l)
     {
         if (l->ntokens >= 3 && !wcscmp(l->tokens[0], L"management"))
         {
-            /* we require the address to be a numerical ipv4 address -- e.g., 127.0.0.1*/
-            if (InetPtonW(AF_INET, l->tokens[1], &addr->sin_addr) != 1)
-            {
-                config_list_free(head);
-                return false;
-            }
-
-            addr->sin_port = htons(_wtoi(l->tokens[2]));
+            mgmt_host = l->tokens[1];
+            mgmt_port = l->tokens[2];
             pw_file = l->tokens[3]; /* may be null */
         }
         else if (l->ntokens >= 2 && !wcscmp(l->tokens[0], L"cd"))
@@ -911,7 +955,13 @@ ParseManagementAddress(connection_t *c)
         l = l->next;
     }
 
-    ret = (addr->sin_port != 0);
+    /* we require a numerical ipv4 or ipv6 address -- e.g., 127.0.0.1 */
+    c->manage.skaddr_len = 0;
+    if (mgmt_host)
+    {
+        c->manage.skaddr_len = ParseManagementEndpoint(mgmt_host, mgmt_port, &c->manage.skaddr);
+    }
+    ret = (c->manage.skaddr_len != 0);
 
     if (ret && pw_file)
     {
@@ -924,15 +974,18 @@ ParseManagementAddress(connection_t *c)
             wcsncpy_s(pw_path, MAX_PATH, pw_file, _TRUNCATE);
         }
 
+        char *password = GetManagementPassword(c);
         FILE *fp = _wfopen(pw_path, L"r");
-        if (!fp
-            || !fgets(c->manage.password, sizeof(c->manage.password), fp))
+        if (!fp || !password
+            || !fgets(password, MGMT_PASSWORD_SIZE, fp))
         {
             /* This may be normal as not all users may be given access to this secret */
             ret = false;
         }
-
-        StrTrimA(c->manage.password, "\n\r");
+        else
+        {
+            StrTrimA(password, "\n\r");
+        }
 
         if (fp)
         {
@@ -941,8 +994,12 @@ ParseManagementAddress(connection_t *c)
     }
     config_list_free(head);
 
-    PrintDebug(L"ParseManagementAddress: host = %hs port = %d passwd_file = %s",
-               inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), pw_path);
+    wchar_t endpoint[64] = L"";
+    if (c->manage.skaddr_len)
+    {
+        FormatManagementEndpoint(&c->manage.skaddr, endpoint, _countof(endpoint));
+    }
+    PrintDebug(L"ParseManagementAddress: address = %ls passwd_file = %ls", endpoint, pw_path);
 
     return ret;
 }
@@ -109,6 +109,21 @@ char *escape_string(const char *str);
  */
 BOOL find_free_tcp_port(SOCKADDR_IN *addr);
 
+/**
+ * Convert the address arguments of --management to a socket address
+ * @param host : numerical IPv4 or IPv6 address
+ * @param port : port number
+ * @param addr : the address on return
+ * @returns the length of the address, 0 on error.
+ */
+int ParseManagementEndpoint(const wchar_t *host, const wchar_t *port, SOCKADDR_STORAGE *addr);
+
+/**
+ * Format a socket address as the arguments of --management,
+ * e.g., "127.0.0.1 25340" or "::1 25340"
+ */
+void FormatManagementEndpoint(const SOCKADDR_STORAGE *addr, wchar_t *buf, size_t len);
+
 /**
  * Parse the config file of a connection profile for
  * Managegment address and password.
@@ -0,0 +1,179 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include "name_index.h"
+
+#define NAME_INDEX_MIN_SIZE 64
+
+/* FNV-1a over the lower-cased name: names equal but for case hash alike */
+static unsigned int
+hash_name(const wchar_t *name)
+{
+    unsigned int h = 2166136261u;
+
+    for ( ; *name; name++)
+    {
+        h ^= (unsigned int) towlower(*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* names match if equal but for case */
+static int
+name_equal(const wchar_t *a, const wchar_t *b)
+{
+    for ( ; *a && *b; a++, b++)
+    {
+        if (*a != *b && towlower(*a) != towlower(*b))
+        {
+            return 0;
+        }
+    }
+    return *a == *b;
+}
+
+/* slot holding name or the empty slot where it would go */
+static name_index_entry_t *
+find_slot(const name_index_t *ni, const wchar_t *name, unsigned int hash)
+{
+    size_t mask = ni->size - 1;
+    size_t i;
+
+    for (i = hash & mask; ni->slots[i].key; i = (i + 1) & mask)
+    {
+        if (ni->slots[i].hash == hash && name_equal(ni->slots[i].key, name))
+        {
+            break;
+        }
+    }
+    return &ni->slots[i];
+}
+
+static int
+resize(name_index_t *ni, size_t size)
+{
+    name_index_t tmp = { .size = size, .count = ni->count };
+    size_t i;
+
+    tmp.slots = calloc(size, sizeof(*tmp.slots));
+    if (!tmp.slots)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < ni->size; i++)
+    {
+        if (ni->slots[i].key)
+        {
+            *find_slot(&tmp, ni->slots[i].key, ni->slots[i].hash) = ni->slots[i];
+        }
+    }
+
+    free(ni->slots);
+    *ni = tmp;
+    return 1;
+}
+
+int
+name_index_add(name_index_t *ni, const wchar_t *name, void *value)
+{
+    name_index_entry_t *slot;
+    unsigned int hash = hash_name(name);
+
+    /* keep the load factor at or below 1/2 */
+    if (2*(ni->count + 1) > ni->size
+        && !resize(ni, ni->size ? 2*ni->size : NAME_INDEX_MIN_SIZE))
+    {
+        return 0;
+    }
+
+    slot = find_slot(ni, name, hash);
+    if (!slot->key)
+    {
+        slot->key = name;
+        slot->value = value;
+        slot->hash = hash;
+        ni->count++;
+    }
+    return 1;
+}
+
+void *
+name_index_find(const name_index_t *ni, const wchar_t *name)
+{
+    if (ni->count == 0)
+    {
+        return NULL;
+    }
+    return find_slot(ni, name, hash_name(name))->value;
+}
+
+void
+name_index_clear(name_index_t *ni)
+{
+    free(ni->slots);
+    memset(ni, 0, sizeof(*ni));
+}
+
+const wchar_t *
+name_index_intern(name_index_t *ni, const wchar_t *str)
+{
+    wchar_t *copy = name_index_find(ni, str);
+
+    if (copy)
+    {
+        return copy;
+    }
+
+    size_t len = wcslen(str) + 1;
+    copy = malloc(len * sizeof(*copy));
+    if (!copy)
+    {
+        return NULL;
+    }
+    wmemcpy(copy, str, len);
+
+    if (!name_index_add(ni, copy, copy))
+    {
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+void
+name_index_free_interned(name_index_t *ni)
+{
+    size_t i;
+
+    for (i = 0; i < ni->size; i++)
+    {
+        free(ni->slots[i].value);
+    }
+    name_index_clear(ni);
+}
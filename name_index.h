@@ -0,0 +1,65 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+/*
+ * Hash table mapping names, compared case insensitively, to pointers.
+ * Keys are not copied: they must stay valid while in the index.
+ */
+typedef struct {
+    const wchar_t *key;
+    void *value;
+    unsigned int hash;
+} name_index_entry_t;
+
+typedef struct {
+    name_index_entry_t *slots;
+    size_t size;                /* number of slots, a power of 2 */
+    size_t count;
+} name_index_t;
+
+/*
+ * Add name -> value unless name is already present, in which case the
+ * existing entry is kept. Returns 0 if out of memory.
+ */
+int name_index_add(name_index_t *ni, const wchar_t *name, void *value);
+
+/* the value added for name or NULL */
+void *name_index_find(const name_index_t *ni, const wchar_t *name);
+
+/* remove all entries and release memory */
+void name_index_clear(name_index_t *ni);
+
+/*
+ * Return the copy of str kept in ni, adding one if there is no match:
+ * strings equal but for case then share storage and compare equal as
+ * pointers. The first spelling added is kept. Returns NULL if out of
+ * memory. Such an index is released by name_index_free_interned().
+ */
+const wchar_t *name_index_intern(name_index_t *ni, const wchar_t *str);
+
+/* release an index filled by name_index_intern() and its strings */
+void name_index_free_interned(name_index_t *ni);
+
+#endif /* ifndef NAME_INDEX_H */
@@ -419,5 +419,8 @@
 
 /* Timer IDs */
 #define IDT_STOP_TIMER                  2500  /* Timer used to trigger force termination */
+#define IDT_LOG_TIMER                   2501  /* Timer used to flush buffered log lines */
+#define IDT_CONNECT_TIMER               2502  /* Timer used to retry connecting to the management interface */
+#define IDT_READY_TIMER                 2503  /* Timer used to limit the wait for the first management answer */
 
 #endif /* ifndef OPENVPN_GUI_RES_H */
@@ -58,9 +58,12 @@
 #include "access.h"
 #include "save_pass.h"
 #include "env_set.h"
+#include "log_store.h"
 #include "echo.h"
 #include "pkcs11.h"
 #include "service.h"
+#include "registry.h"
+#include "latency.h"
 
 #define OPENVPN_SERVICE_PIPE_NAME_OVPN2 L"\\\\.\\pipe\\openvpn\\service"
 #define OPENVPN_SERVICE_PIPE_NAME_OVPN3 L"\\\\.\\pipe\\ovpnagent"
@@ -73,6 +76,16 @@ static BOOL LaunchOpenVPN(connection_t *c);
 
 const TCHAR *cfgProp = _T("conn");
 
+/*
+ * A log line posted to the connection thread with WM_OVPN_LOG, allocated
+ * in one block by the sender and freed by the receiver.
+ */
+struct log_msg {
+    BOOL fileio;
+    const WCHAR *line;          /* follows the prefix in the same block */
+    WCHAR prefix[];
+};
+
 void
 free_auth_param(auth_param_t *param)
 {
@@ -113,6 +126,108 @@ show_error_tip(HWND editbox, const WCHAR *msg)
     SendMessage(editbox, EM_SHOWBALLOONTIP, 0, (LPARAM)&bt);
 }
 
+/*
+ * Ask for bytecount reports often while the status window is shown
+ * and rarely while it is hidden, which is most of the time.
+ */
+static void
+SetByteCountInterval(connection_t *c, BOOL visible)
+{
+    int interval = visible ? BYTECOUNT_INTERVAL_SHOWN : BYTECOUNT_INTERVAL_HIDDEN;
+    char cmd[32];
+
+    if (c->bytecount_interval == interval)
+    {
+        return;
+    }
+
+    c->bytecount_interval = interval;
+    _snprintf_0(cmd, "bytecount %d", interval);
+    ManagementCommand(c, cmd, NULL, regular);
+}
+
+/*
+ * Connect time histograms of the profile, loaded from the registry
+ * on first use. Returns NULL if out of memory.
+ */
+static latency_stats_t *
+GetLatencyStats(connection_t *c)
+{
+    if (!c->latency)
+    {
+        c->latency = malloc(sizeof(*c->latency));
+        if (!c->latency)
+        {
+            return NULL;
+        }
+        if (GetConfigRegistryValue(c->config_name, L"connect_latency", (BYTE *) c->latency,
+                                   sizeof(*c->latency)) != sizeof(*c->latency)
+            || c->latency->version != LATENCY_VERSION)
+        {
+            latency_stats_init(c->latency);
+        }
+        latency_timer_reset(&c->latency_timer);
+    }
+    return c->latency;
+}
+
+/* Write the percentiles of a connect phase to the status window */
+static void
+ShowLatency(connection_t *c, latency_phase_t phase)
+{
+    const latency_hist_t *h = &c->latency->phase[phase];
+    WCHAR msg[256];
+
+    _sntprintf_0(msg, L"Connect time %hs: p50 %.1f s, p95 %.1f s, p99 %.1f s over %lu",
+                 latency_phase_name(phase), latency_percentile(h, 0.50) / 1000.0,
+                 latency_percentile(h, 0.95) / 1000.0, latency_percentile(h, 0.99) / 1000.0,
+                 latency_count(h));
+    WriteStatusLog(c, L"GUI> ", msg, false);
+}
+
+/* Write the percentiles of every connect phase timed so far */
+static void
+DumpLatency(connection_t *c)
+{
+    if (!GetLatencyStats(c))
+    {
+        return;
+    }
+    for (int i = 0; i < LATENCY_PHASES; i++)
+    {
+        if (latency_count(&c->latency->phase[i]) > 0)
+        {
+            ShowLatency(c, i);
+        }
+    }
+}
+
+/*
+ * Time the phases of connecting from the state changes. States
+ * replayed on attaching to a running daemon carry an old timestamp
+ * and are not timed. Histograms are saved after each completed
+ * attempt to survive restarts of the GUI.
+ */
+static void
+RecordLatency(connection_t *c, time_t timestamp, const char *state)
+{
+    if (!GetLatencyStats(c))
+    {
+        return;
+    }
+    if (timestamp + 2 < time(NULL))
+    {
+        latency_timer_reset(&c->latency_timer);
+        return;
+    }
+    if (latency_state_change(c->latency, &c->latency_timer, state, GetTickCount64()))
+    {
+        SetConfigRegistryValueBinary(c->config_name, L"connect_latency", (BYTE *) c->latency,
+                                     sizeof(*c->latency));
+        ShowLatency(c, latency_total);
+    }
+}
+
 /*
  * Receive banner on connection to management interface
  * Format: <BANNER>
@@ -123,7 +238,9 @@ OnReady(connection_t *c, UNUSED char *msg)
     ManagementCommand(c, "state on", NULL, regular);
     ManagementCommand(c, "log on all", OnLogLine, combined);
     ManagementCommand(c, "echo on all", OnEcho, combined);
-    ManagementCommand(c, "bytecount 5", NULL, regular);
+    c->bytecount_interval = 0;
+    SetByteCountInterval(c, IsWindowVisible(c->hwndStatus));
+    latency_timer_reset(&c->latency_timer);
 
     /* ask for the current state, especially useful when the daemon was prestarted */
     ManagementCommand(c, "state", OnStateChange, regular);
@@ -147,7 +264,7 @@ OnHold(connection_t *c, UNUSED char *msg)
         && (c->state == disconnecting || c->state == resuming))
     {
         /* retain the hold state if we are here while disconnecting  */
-        c->state = onhold;
+        SetConnState(c, onhold);
         SetMenuStatus(c, onhold);
         SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_ONHOLD));
         SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -161,77 +278,232 @@ OnHold(connection_t *c, UNUSED char *msg)
 }
 
 /*
- * Handle a log line from the OpenVPN management interface
- * Format <TIMESTAMP>,<FLAGS>,<MESSAGE>
+ * Set the colour used for text appended to the log window
  */
-void
-OnLogLine(connection_t *c, char *line)
+static void
+SetLogColor(HWND logWnd, log_class_t class)
 {
-    HWND logWnd = GetDlgItem(c->hwndStatus, ID_EDT_LOG);
-    char *flags, *message;
-    time_t timestamp;
-    TCHAR *datetime;
-    const SETTEXTEX ste = {
-        .flags = ST_SELECTION,
-        .codepage = CP_UTF8
-    };
+    CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
+                       .dwMask = CFM_COLOR|CFM_BOLD,
+                       .dwEffects = 0, };
+
+    if (class == log_class_error)
+    {
+        cfm.crTextColor = o.clr_error;
+    }
+    else if (class == log_class_warning)
+    {
+        cfm.crTextColor = o.clr_warning;
+    }
+
+    if (cfm.crTextColor == 0)
+    {
+        cfm.dwEffects = CFE_AUTOCOLOR;
+    }
+    SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
+}
 
-    flags = strchr(line, ',') + 1;
-    if (flags - 1 == NULL)
+/*
+ * Append the GUI lines buffered for the log file. The file is opened
+ * per batch rather than kept open as openvpn.exe opens it without
+ * write sharing when (re)started.
+ */
+static void
+FlushLogFile(connection_t *c)
+{
+    FILE *log_fd;
+
+    if (c->log_writer.len == 0)
     {
         return;
     }
 
-    message = strchr(flags, ',') + 1;
-    if (message - 1 == NULL)
+    log_fd = _tfopen(c->log_path, TEXT("at+,ccs=UTF-8"));
+    if (log_fd)
     {
+        fputws(c->log_writer.text, log_fd);
+        fclose(log_fd);
+    }
+    log_writer_clear(&c->log_writer);
+}
+
+/*
+ * Append the pending log records to the log window. The window shows the records
+ * [log_shown, log_flushed) of the store, so lines can be removed from
+ * its top by a character count known from the store rather than by
+ * querying the control. Consecutive lines of the same colour are
+ * appended in one go. Until the log window is created lines are only
+ * kept in the store.
+ */
+static void
+FlushLogStore(connection_t *c)
+{
+    log_store_t *ls = &c->log_store;
+    HWND logWnd = c->hwndLog;
+    unsigned long long end = log_store_end(ls);
+    unsigned long long from = max(c->log_flushed, ls->first_seq);
+    unsigned long long keep_from = c->log_shown;
+    unsigned long long seq;
+    const log_record_t *rec;
+
+    if (!logWnd)
+    {
+        return;
+    }
+    if (from == end)
+    {
+        c->log_flushed = end;
         return;
     }
-    size_t flag_size = message - flags - 1; /* message is always > flags */
 
     /* Remove lines from log window if it is getting full */
-    if (SendMessage(logWnd, EM_GETLINECOUNT, 0, 0) > MAX_LOG_LINES)
+    if (end - c->log_shown > MAX_LOG_LINES)
     {
-        int pos = SendMessage(logWnd, EM_LINEINDEX, DEL_LOG_LINES, 0);
-        SendMessage(logWnd, EM_SETSEL, 0, pos);
-        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
+        keep_from = end - MAX_LOG_LINES + DEL_LOG_LINES;
     }
+    unsigned long long render_from = max(from, keep_from);
+
+    SendMessage(logWnd, WM_SETREDRAW, FALSE, 0);
 
-    timestamp = strtol(line, NULL, 10);
-    datetime = _tctime(&timestamp);
-    datetime[24] = _T(' ');
+    if (keep_from >= c->log_flushed            /* nothing shown is kept */
+        || render_from > c->log_flushed        /* pending lines were evicted */
+        || (keep_from > c->log_shown && c->log_shown < ls->first_seq))
+    {
+        SendMessage(logWnd, EM_SETSEL, 0, -1);
+        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
+        c->log_shown = render_from;
+    }
+    else if (keep_from > c->log_shown)
+    {
+        /* each line including its newline is one character per code unit */
+        size_t chars = 0;
+        for (seq = c->log_shown; seq < keep_from; seq++)
+        {
+            chars += log_store_get(ls, seq)->len;
+        }
+        SendMessage(logWnd, EM_SETSEL, 0, chars);
+        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
+        c->log_shown = keep_from;
+    }
 
     /* deselect current selection, if any */
     SendMessage(logWnd, EM_SETSEL, (WPARAM) -1, (LPARAM) -1);
 
-    /* change text color if Warning or Error */
-    COLORREF text_clr = 0;
+    for (seq = render_from; seq < end; )
+    {
+        const log_record_t *first = log_store_get(ls, seq);
+        const log_record_t *last = first;
+
+        /* extend the run while lines have the same colour and are adjacent in the text ring */
+        while (++seq < end)
+        {
+            rec = log_store_get(ls, seq);
+            if (rec->class != first->class || rec->offset != last->offset + last->len)
+            {
+                break;
+            }
+            last = rec;
+        }
+
+        /* terminate the text after the last line of the run */
+        WCHAR *stop = ls->text + last->offset + last->len;
+        WCHAR saved = *stop;
+        *stop = L'\0';
+
+        SetLogColor(logWnd, first->class);
+        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) (ls->text + first->offset));
+        *stop = saved;
+    }
+
+    SendMessage(logWnd, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(logWnd, NULL, TRUE);
+
+    /* scroll to the caret */
+    SendMessage(logWnd, EM_SCROLLCARET, 0, 0);
 
-    if (memchr(flags, 'N', flag_size) || memchr(flags, 'F', flag_size))
+    c->log_flushed = end;
+}
+
+/* Write out all pending log lines */
+static void
+FlushLog(connection_t *c)
+{
+    if (c->log_timer)
     {
-        text_clr = o.clr_error;
+        KillTimer(c->hwndStatus, IDT_LOG_TIMER);
+        c->log_timer = FALSE;
     }
-    else if (memchr(flags, 'W', flag_size))
+    FlushLogStore(c);
+    FlushLogFile(c);
+}
+
+/*
+ * Called after a line has been added to the connection's log store or
+ * file buffer. Lines are written out from a timer so that a burst of log
+ * output costs a single update of the log window and a single write to
+ * the file. A large backlog is flushed right away. Without a log window
+ * there is nothing to render and the timer is not armed: file output is
+ * written at once and the store is shown when the window is created.
+ */
+static void
+QueueLogLine(connection_t *c)
+{
+    if (!c->hwndLog)
     {
-        text_clr = o.clr_warning;
+        FlushLogFile(c);
     }
+    else if (log_store_end(&c->log_store) - c->log_flushed >= MAX_LOG_LINES
+             || c->log_writer.len >= LOG_FILE_FLUSH_SIZE)
+    {
+        FlushLog(c);
+    }
+    else if (!c->log_timer)
+    {
+        c->log_timer = SetTimer(c->hwndStatus, IDT_LOG_TIMER, LOG_FLUSH_INTERVAL, NULL) != 0;
+    }
+}
 
-    if (text_clr != 0)
+/*
+ * Handle a log line from the OpenVPN management interface
+ * Format <TIMESTAMP>,<FLAGS>,<MESSAGE>
+ */
+void
+OnLogLine(connection_t *c, char *line)
+{
+    const char *message;
+    log_class_t class;
+    time_t timestamp;
+    WCHAR *datetime;
+    WCHAR *p;
+    int len = 0;
+
+    if (!c->hwndStatus || !log_parse_mgmt_line(line, &timestamp, &class, &message))
     {
-        CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
-                           .dwMask = CFM_COLOR|CFM_BOLD,
-                           .dwEffects = 0,
-                           .crTextColor = text_clr, };
-        SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
+        return;
     }
 
-    /* Append line to log window */
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) datetime);
-    SendMessage(logWnd, EM_SETTEXTEX, (WPARAM) &ste, (LPARAM) message);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T("\n"));
+    datetime = _wctime(&timestamp);
+    if (!datetime)
+    {
+        return;
+    }
+    datetime[24] = L' ';
 
-    /* scroll to the caret */
-    SendMessage(logWnd, EM_SCROLLCARET, 0, 0);
+    /* UTF-16 never takes more code units than the UTF-8 input has bytes */
+    size_t msg_len = min(strlen(message), LOG_STORE_MAX_LINE - 25);
+    p = log_store_reserve(&c->log_store, 25 + msg_len);
+    if (!p)
+    {
+        return;
+    }
+    wmemcpy(p, datetime, 25);
+
+    if (msg_len > 0)
+    {
+        len = MultiByteToWideChar(CP_UTF8, 0, message, (int) msg_len, p + 25, (int) msg_len);
+    }
+    log_store_commit(&c->log_store, 25 + len, timestamp, class, 0);
+    QueueLogLine(c);
 }
 
 /* expect ipv4,remote,port,,,ipv6 */
@@ -336,6 +608,11 @@ OnStateChange(connection_t *c, char *data)
 
     strncpy_s(c->daemon_state, _countof(c->daemon_state), state, _TRUNCATE);
 
+    RecordLatency(c, (time_t) atoi(data), state);
+
+    /* save GUI lines meant for the log file at every state transition */
+    FlushLogFile(c);
+
     /* Connected state message could be SUCCESS or ERROR, ROUTE_ERROR.
      * We treat both SUCCESS and ROUTE_ERROR similarly to preserve the
      * current behaviour but show the status window and do not change
@@ -391,7 +668,7 @@ OnStateChange(connection_t *c, char *data)
         c->connected_since = atoi(data);
         c->failed_psw_attempts = 0;
         c->failed_auth_attempts = 0;
-        c->state = connected;
+        SetConnState(c, connected);
 
         SetMenuStatus(c, connected);
         SetTrayIcon(connected);
@@ -428,7 +705,7 @@ OnStateChange(connection_t *c, char *data)
         /* We change the state to reconnecting only if there was a prior successful connection. */
         if (c->state == connected)
         {
-            c->state = reconnecting;
+            SetConnState(c, reconnecting);
 
             /* Update the tray icon */
             CheckAndSetTrayIcon();
@@ -1501,7 +1778,7 @@ OnTimeout(connection_t *c, UNUSED char *msg)
     }
     WriteStatusLog(c, L"GUI> ", LoadLocalizedString(IDS_NFO_CONN_TIMEOUT, c->log_path), false);
     WriteStatusLog(c, L"GUI> ", L"Retrying. Press disconnect to abort", false);
-    c->state = connecting;
+    SetConnState(c, connecting);
     if (!OpenManagement(c))
     {
         MessageBoxExW(c->hwndStatus, L"Failed to open management", _T(PACKAGE_NAME),
@@ -1518,6 +1795,9 @@ void
 OnStop(connection_t *c, UNUSED char *msg)
 {
     UINT txt_id, msg_id;
+
+    /* show and save pending log lines before any message box pops up */
+    FlushLog(c);
     SetMenuStatus(c, disconnected);
 
     switch (c->state)
@@ -1526,7 +1806,7 @@ OnStop(connection_t *c, UNUSED char *msg)
             /* OpenVPN process ended unexpectedly */
             c->failed_psw_attempts = 0;
             c->failed_auth_attempts = 0;
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             CheckAndSetTrayIcon();
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_DISCONNECTED));
             SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -1549,9 +1829,9 @@ OnStop(connection_t *c, UNUSED char *msg)
             txt_id = c->state == reconnecting ? IDS_NFO_STATE_FAILED_RECONN : IDS_NFO_STATE_FAILED;
             msg_id = c->state == reconnecting ? IDS_NFO_RECONN_FAILED : IDS_NFO_CONN_FAILED;
 
-            c->state = disconnecting;
+            SetConnState(c, disconnecting);
             CheckAndSetTrayIcon();
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             SetStatusWinIcon(c->hwndStatus, ID_ICO_DISCONNECTED);
@@ -1570,7 +1850,7 @@ OnStop(connection_t *c, UNUSED char *msg)
             /* Shutdown was initiated by us */
             c->failed_psw_attempts = 0;
             c->failed_auth_attempts = 0;
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             if (c->flags & FLAG_DAEMON_PERSISTENT)
             {
                 /* user initiated disconnection -- stay detached and do not auto-reconnect */
@@ -1584,13 +1864,13 @@ OnStop(connection_t *c, UNUSED char *msg)
         case onhold:
         /* stop triggered while on hold -- possibly the daemon exited. Treat same as detaching */
         case detaching:
-            c->state = disconnected;
+            SetConnState(c, disconnected);
             CheckAndSetTrayIcon();
             SendMessage(c->hwndStatus, WM_CLOSE, 0, 0);
             break;
 
         case suspending:
-            c->state = suspended;
+            SetConnState(c, suspended);
             CheckAndSetTrayIcon();
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_SUSPENDED));
             break;
@@ -1630,6 +1910,85 @@ format_bytecount(wchar_t *buf, size_t len, unsigned long long c)
     return buf;
 }
 
+/* Convert a rate in bytes per second to a human readable string */
+static wchar_t *
+format_rate(wchar_t *buf, size_t len, double x)
+{
+    const char *suf[] = {"B", "KiB", "MiB", "GiB", "TiB", NULL};
+    const char **s = suf;
+
+    while (x > 1024 && *(s+1))
+    {
+        x /= 1024.0;
+        s++;
+    }
+    swprintf(buf, len, L"%.1f %hs/s", x, *s);
+    buf[len-1] = L'\0';
+
+    return buf;
+}
+
+/* Display the last bytecount received and the current rates in the status window */
+static void
+ShowByteCount(connection_t *c)
+{
+    wchar_t in[64], out[64];
+    format_bytecount(in, _countof(in), c->bytes_in);
+    format_bytecount(out, _countof(out), c->bytes_out);
+    if (c->throughput && c->throughput->sample_count > 1)
+    {
+        wchar_t rate[32];
+        size_t len = wcslen(in);
+        swprintf(in + len, _countof(in) - len, L", %ls",
+                 format_rate(rate, _countof(rate), c->throughput->rate_in));
+        len = wcslen(out);
+        swprintf(out + len, _countof(out) - len, L", %ls",
+                 format_rate(rate, _countof(rate), c->throughput->rate_out));
+    }
+    SetDlgItemTextW(c->hwndStatus, ID_TXT_BYTECOUNT,
+                    LoadLocalizedString(IDS_NFO_BYTECOUNT, in, out));
+}
+
+/*
+ * Write the traffic history of the connection as CSV next to its
+ * log file, replacing the .log extension by .csv.
+ */
+static void
+ExportThroughput(connection_t *c)
+{
+    WCHAR path[MAX_PATH];
+    WCHAR msg[MAX_PATH + 64];
+    size_t len;
+    FILE *fp;
+
+    _sntprintf_0(path, L"%ls", c->log_path);
+    len = wcslen(path);
+    if (len > 4 && !_wcsicmp(path + len - 4, L".log"))
+    {
+        len -= 4;
+    }
+    if (len + 4 >= _countof(path) || !c->throughput)
+    {
+        return;
+    }
+    wcscpy(path + len, L".csv");
+
+    fp = _wfopen(path, L"w");
+    if (fp && throughput_write_csv(c->throughput, fp) && fclose(fp) == 0)
+    {
+        _sntprintf_0(msg, L"Throughput history written to %ls", path);
+    }
+    else
+    {
+        if (fp)
+        {
+            fclose(fp);
+        }
+        _sntprintf_0(msg, L"Failed to write throughput history to %ls", path);
+    }
+    WriteStatusLog(c, L"GUI> ", msg, false);
+}
+
 /*
  * Handle bytecount report from OpenVPN
  * Expect bytes-in,bytes-out
@@ -1641,11 +2000,25 @@ OnByteCount(connection_t *c, char *msg)
     {
         return;
     }
-    wchar_t in[32], out[32];
-    format_bytecount(in, _countof(in), c->bytes_in);
-    format_bytecount(out, _countof(out), c->bytes_out);
-    SetDlgItemTextW(c->hwndStatus, ID_TXT_BYTECOUNT,
-                    LoadLocalizedString(IDS_NFO_BYTECOUNT, in, out));
+
+    if (!c->throughput)
+    {
+        c->throughput = malloc(sizeof(*c->throughput));
+        if (c->throughput)
+        {
+            throughput_reset(c->throughput);
+        }
+    }
+    if (c->throughput)
+    {
+        throughput_add(c->throughput, time(NULL), c->bytes_in, c->bytes_out);
+    }
+
+    /* shown from the saved values when the window is displayed */
+    if (IsWindowVisible(c->hwndStatus))
+    {
+        ShowByteCount(c);
+    }
 }
 
 /*
@@ -1759,8 +2132,6 @@ WriteStatusLog(connection_t *c, const WCHAR *prefix, const WCHAR *line, BOOL fil
         return;
     }
 
-    HWND logWnd = GetDlgItem(c->hwndStatus, ID_EDT_LOG);
-    FILE *log_fd;
     time_t now;
     WCHAR datetime[26];
 
@@ -1769,53 +2140,50 @@ WriteStatusLog(connection_t *c, const WCHAR *prefix, const WCHAR *line, BOOL fil
     wcsncpy(datetime, _wctime(&now), _countof(datetime));
     datetime[24] = L' ';
 
-    /* change text color if Warning or Error */
-    COLORREF text_clr = 0;
-
-    if (wcsstr(prefix, L"ERROR"))
-    {
-        text_clr = o.clr_error;
-    }
-    else if (wcsstr(prefix, L"WARNING"))
-    {
-        text_clr = o.clr_warning;
-    }
-
-    if (text_clr != 0)
-    {
-        CHARFORMAT cfm = { .cbSize = sizeof(CHARFORMAT),
-                           .dwMask = CFM_COLOR|CFM_BOLD,
-                           .dwEffects = 0,
-                           .crTextColor = text_clr, };
-        SendMessage(logWnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM) &cfm);
-    }
+    log_class_t class = log_classify_prefix(prefix);
+    BOOL file_only = !c->hwndStatus || !c->log_store.max_lines;
 
-
-    /* Remove lines from log window if it is getting full */
-    if (SendMessage(logWnd, EM_GETLINECOUNT, 0, 0) > MAX_LOG_LINES)
+    /* The log store belongs to the connection thread: hand a copy over.
+     * Posting does not wait for that thread, which may itself be waiting
+     * for the caller.
+     */
+    if (GetCurrentThreadId() != c->threadId && c->hwndStatus)
     {
-        int pos = SendMessage(logWnd, EM_LINEINDEX, DEL_LOG_LINES, 0);
-        SendMessage(logWnd, EM_SETSEL, 0, pos);
-        SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) _T(""));
+        size_t prefix_len = wcslen(prefix) + 1;
+        size_t line_len = wcslen(line) + 1;
+        struct log_msg *lm = malloc(sizeof(*lm) + (prefix_len + line_len) * sizeof(WCHAR));
+        if (lm)
+        {
+            lm->fileio = fileio;
+            wmemcpy(lm->prefix, prefix, prefix_len);
+            lm->line = wmemcpy(lm->prefix + prefix_len, line, line_len);
+            if (PostMessage(c->hwndStatus, WM_OVPN_LOG, 0, (LPARAM) lm))
+            {
+                return;
+            }
+            free(lm);
+        }
+        file_only = TRUE;
     }
-    /* Append line to log window */
-    SendMessage(logWnd, EM_SETSEL, (WPARAM) -1, (LPARAM) -1);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) datetime);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) prefix);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) line);
-    SendMessage(logWnd, EM_REPLACESEL, FALSE, (LPARAM) L"\n");
 
-    if (!fileio)
+    /* no window: only the log file can be written */
+    if (file_only)
     {
+        FILE *log_fd;
+        if (fileio && (log_fd = _tfopen(c->log_path, TEXT("at+,ccs=UTF-8"))))
+        {
+            fwprintf(log_fd, L"%ls%ls%ls\n", datetime, prefix, line);
+            fclose(log_fd);
+        }
         return;
     }
 
-    log_fd = _tfopen(c->log_path, TEXT("at+,ccs=UTF-8"));
-    if (log_fd)
+    log_store_append(&c->log_store, now, class, 0, datetime, prefix, line);
+    if (fileio)
     {
-        fwprintf(log_fd, L"%ls%ls%ls\n", datetime, prefix, line);
-        fclose(log_fd);
+        log_writer_append(&c->log_writer, datetime, prefix, line);
     }
+    QueueLogLine(c);
 }
 
 #define IO_TIMEOUT 5000 /* milliseconds */
@@ -1843,9 +2211,16 @@ static BOOL
 InitServiceIO(service_io_t *s)
 {
     DWORD dwMode = o.ovpn_engine == OPENVPN_ENGINE_OVPN3 ? PIPE_READMODE_BYTE : PIPE_READMODE_MESSAGE;
+    WCHAR *readbuf = s->readbuf; /* kept for reuse, freed in Cleanup */
 
     CLEAR(*s);
 
+    s->readbuf = readbuf ? readbuf : calloc(SERVICE_IO_READBUF_LEN, sizeof(*s->readbuf));
+    if (!s->readbuf)
+    {
+        return FALSE;
+    }
+
     /* auto-reset event used for signalling i/o completion*/
     s->hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
     if (!s->hEvent)
@@ -1879,7 +2254,7 @@ HandleServiceIO(DWORD err, DWORD bytes, LPOVERLAPPED lpo)
     service_io_t *s = (service_io_t *) lpo;
     int len, capacity;
 
-    len = _countof(s->readbuf);
+    len = SERVICE_IO_READBUF_LEN;
     capacity = (len-1)*sizeof(*(s->readbuf));
 
     if (bytes > 0)
@@ -2168,6 +2543,11 @@ Cleanup(connection_t *c)
     c->es = NULL;
     echo_msg_clear(c, true); /* clear history */
     pkcs11_list_clear(&c->pkcs11_list);
+    FlushLogFile(c);
+    log_writer_free(&c->log_writer);
+    log_store_free(&c->log_store);
+    c->log_shown = c->log_flushed = 0;
+    c->log_timer = FALSE;
 
     if (c->hProcess)
     {
@@ -2179,6 +2559,9 @@ Cleanup(connection_t *c)
     {
         CloseServiceIO(&c->iserv);
     }
+    free(c->iserv.readbuf);
+    c->iserv.readbuf = NULL;
+    FreeManagementPassword(c);
 
     if (c->exit_event)
     {
@@ -2205,6 +2588,63 @@ RenderStatusWindow(HWND hwndDlg, UINT w, UINT h)
     MoveWindow(GetDlgItem(hwndDlg, ID_HIDE), w - DPI_SCALE(94), h - DPI_SCALE(34), DPI_SCALE(85), DPI_SCALE(25), TRUE);
 }
 
+/* Number of status windows closed without ever showing their log */
+static LONG log_windows_avoided;
+
+/*
+ * Create the log window of a status dialog unless it exists and fill
+ * it with the lines kept in the log store. This is deferred until the
+ * dialog is shown: most connections started silently or attached in
+ * the background never need the rich edit control and its text.
+ */
+static void
+CreateLogWindow(connection_t *c)
+{
+    if (c->hwndLog)
+    {
+        return;
+    }
+
+    HWND hLogWnd = CreateWindowEx(WS_EX_STATICEDGE, RICHEDIT_CLASS, NULL,
+                                  WS_CHILD|WS_VISIBLE|WS_HSCROLL|WS_VSCROLL|ES_LEFT
+                                  |ES_MULTILINE|ES_READONLY|ES_AUTOHSCROLL|ES_AUTOVSCROLL,
+                                  20, 25, 350, 160, c->hwndStatus, (HMENU) ID_EDT_LOG, o.hInstance, NULL);
+    if (!hLogWnd)
+    {
+        ShowLocalizedMsgEx(MB_OK|MB_ICONERROR, c->hwndStatus, TEXT(PACKAGE_NAME), IDS_ERR_CREATE_EDIT_LOGWINDOW);
+        return;
+    }
+
+    /* Add some padding */
+    RECT rc;
+    GetClientRect(hLogWnd, &rc);
+    InflateRect(&rc, -9, -9);
+    SendMessage(hLogWnd, EM_SETRECT, 0, (LPARAM)&rc);
+
+    /* Set font and fontsize of the log window */
+    CHARFORMAT cfm = {
+        .cbSize = sizeof(CHARFORMAT),
+        .dwMask = CFM_SIZE|CFM_FACE|CFM_BOLD,
+        .szFaceName = _T("Microsoft Sans Serif"),
+        .dwEffects = 0,
+        .yHeight = 160
+    };
+    if (SendMessage(hLogWnd, EM_SETCHARFORMAT, SCF_DEFAULT, (LPARAM) &cfm) == 0)
+    {
+        ShowLocalizedMsgEx(MB_OK|MB_ICONERROR, c->hwndStatus, TEXT(PACKAGE_NAME), IDS_ERR_SET_SIZE);
+    }
+
+    /* Set size and position */
+    RECT rect;
+    GetClientRect(c->hwndStatus, &rect);
+    RenderStatusWindow(c->hwndStatus, rect.right, rect.bottom);
+
+    /* show the lines kept so far */
+    c->hwndLog = hLogWnd;
+    c->log_shown = c->log_flushed = c->log_store.first_seq;
+    FlushLogStore(c);
+}
+
 /*
  * DialogProc for OpenVPN status dialog windows
  */
@@ -2212,12 +2652,15 @@ INT_PTR CALLBACK
 StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     connection_t *c;
+    struct log_msg *lm;
+    MSG pending;
 
     switch (msg)
     {
         case WM_MANAGEMENT:
             /* Management interface related event */
-            OnManagement(wParam, lParam);
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            OnManagement(c, wParam, lParam);
             return TRUE;
 
         case WM_INITDIALOG:
@@ -2236,37 +2679,8 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
                 break;
             }
 
-            /* Create log window */
-            HWND hLogWnd = CreateWindowEx(WS_EX_STATICEDGE, RICHEDIT_CLASS, NULL,
-                                          WS_CHILD|WS_VISIBLE|WS_HSCROLL|WS_VSCROLL|ES_LEFT
-                                          |ES_MULTILINE|ES_READONLY|ES_AUTOHSCROLL|ES_AUTOVSCROLL,
-                                          20, 25, 350, 160, hwndDlg, (HMENU) ID_EDT_LOG, o.hInstance, NULL);
-            if (!hLogWnd)
-            {
-                ShowLocalizedMsgEx(MB_OK|MB_ICONERROR, c->hwndStatus, TEXT(PACKAGE_NAME), IDS_ERR_CREATE_EDIT_LOGWINDOW);
-                /* We can't continue without a log window */
-                StopOpenVPN(c);
-                return FALSE;
-            }
-
-            /* Add some padding */
-            RECT rc;
-            GetClientRect(hLogWnd, &rc);
-            InflateRect(&rc, -9, -9);
-            SendMessage(hLogWnd, EM_SETRECT, 0, (LPARAM)&rc);
-
-            /* Set font and fontsize of the log window */
-            CHARFORMAT cfm = {
-                .cbSize = sizeof(CHARFORMAT),
-                .dwMask = CFM_SIZE|CFM_FACE|CFM_BOLD,
-                .szFaceName = _T("Microsoft Sans Serif"),
-                .dwEffects = 0,
-                .yHeight = 160
-            };
-            if (SendMessage(hLogWnd, EM_SETCHARFORMAT, SCF_DEFAULT, (LPARAM) &cfm) == 0)
-            {
-                ShowLocalizedMsgEx(MB_OK|MB_ICONERROR, c->hwndStatus, TEXT(PACKAGE_NAME), IDS_ERR_SET_SIZE);
-            }
+            /* The log window is created when the dialog is first shown */
+            c->hwndLog = NULL;
 
             /* display version string as "OpenVPN GUI gui_version/core_version" */
             wchar_t version[256];
@@ -2291,8 +2705,6 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             {
                 ShowWindow(GetDlgItem(hwndDlg, ID_DETACH), SW_HIDE);
             }
-            /* Set focus on the LogWindow so it scrolls automatically */
-            SetFocus(hLogWnd);
             return FALSE;
 
         case WM_DPICHANGED:
@@ -2340,10 +2752,21 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             break;
 
         case WM_SHOWWINDOW:
-            if (wParam == TRUE)
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            if (wParam == TRUE && c)
             {
+                CreateLogWindow(c);
                 SetFocus(GetDlgItem(hwndDlg, ID_EDT_LOG));
             }
+            /* reports are requested once the management interface is ready */
+            if (c && c->manage.connected > 1 && c->bytecount_interval)
+            {
+                if (wParam == TRUE)
+                {
+                    ShowByteCount(c);
+                }
+                SetByteCountInterval(c, (BOOL) wParam);
+            }
             return FALSE;
 
         case WM_CLOSE:
@@ -2360,6 +2783,25 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 
         case WM_NCDESTROY:
             KillTimer(hwndDlg, IDT_STOP_TIMER);
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            if (c)
+            {
+                if (!c->hwndLog)
+                {
+                    /* process-wide diagnostic, not part of the connection's log */
+                    PrintDebug(L"Status window of %ls closed without a log window (%ld so far)",
+                               c->config_name, InterlockedIncrement(&log_windows_avoided));
+                }
+                c->hwndLog = NULL;
+
+                /* lines posted by other threads and not yet received */
+                while (PeekMessage(&pending, hwndDlg, WM_OVPN_LOG, WM_OVPN_LOG, PM_REMOVE))
+                {
+                    lm = (struct log_msg *) pending.lParam;
+                    WriteStatusLog(c, lm->prefix, lm->line, lm->fileio);
+                    free(lm);
+                }
+            }
             RemoveProp(hwndDlg, cfgProp);
             break;
 
@@ -2369,7 +2811,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 
         case WM_OVPN_RELEASE:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
-            c->state = reconnecting;
+            SetConnState(c, reconnecting);
             SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_RECONNECTING));
             SetDlgItemTextW(c->hwndStatus, ID_TXT_IP, L"");
             SetStatusWinIcon(c->hwndStatus, ID_ICO_CONNECTING);
@@ -2384,7 +2826,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             {
                 break;
             }
-            c->state = disconnecting;
+            SetConnState(c, disconnecting);
             if (!(c->flags & FLAG_DAEMON_PERSISTENT))
             {
                 RunDisconnectScript(c, false);
@@ -2396,10 +2838,20 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             DisconnectDaemon(c);
             break;
 
+        case WM_OVPN_THROUGHPUT:
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            ExportThroughput(c);
+            break;
+
+        case WM_OVPN_LATENCY:
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            DumpLatency(c);
+            break;
+
         case WM_OVPN_DETACH:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
             /* just stop the thread keeping openvpn.exe running */
-            c->state = detaching;
+            SetConnState(c, detaching);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             OnStop(c, NULL);
@@ -2407,7 +2859,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
 
         case WM_OVPN_SUSPEND:
             c = (connection_t *) GetProp(hwndDlg, cfgProp);
-            c->state = suspending;
+            SetConnState(c, suspending);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_DISCONNECT), FALSE);
             EnableWindow(GetDlgItem(c->hwndStatus, ID_RESTART), FALSE);
             SetMenuStatus(c, disconnecting);
@@ -2426,6 +2878,25 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
                 KillTimer(hwndDlg, IDT_STOP_TIMER);
                 OnStop(c, NULL);
             }
+            else if (wParam == IDT_LOG_TIMER)
+            {
+                FlushLog(c);
+            }
+            else if (wParam == IDT_CONNECT_TIMER)
+            {
+                RetryManagement(c);
+            }
+            else if (wParam == IDT_READY_TIMER)
+            {
+                OnReadyTimeout(c);
+            }
+            break;
+
+        case WM_OVPN_LOG: /* log line written from another thread */
+            c = (connection_t *) GetProp(hwndDlg, cfgProp);
+            lm = (struct log_msg *) lParam;
+            WriteStatusLog(c, lm->prefix, lm->line, lm->fileio);
+            free(lm);
             break;
 
         case WM_OVPN_RESTART:
@@ -2433,7 +2904,7 @@ StatusDialogFunc(HWND hwndDlg, UINT msg, WPARAM wParam, LPARAM lParam)
             /* external messages can trigger when we are not ready -- check the state */
             if (IsWindowEnabled(GetDlgItem(c->hwndStatus, ID_RESTART)))
             {
-                c->state = reconnecting;
+                SetConnState(c, reconnecting);
                 ManagementCommand(c, "signal SIGHUP", NULL, regular);
                 SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_RECONNECTING));
                 SetDlgItemTextW(c->hwndStatus, ID_TXT_IP, L"");
@@ -2459,7 +2930,9 @@ ThreadOpenVPNStatus(void *p)
     TCHAR conn_name[200];
     MSG msg;
     HANDLE wait_event;
+    BOOL from_queue = c->from_queue;
 
+    c->from_queue = FALSE;
     CLEAR(msg);
     srand(c->threadId);
 
@@ -2467,6 +2940,8 @@ ThreadOpenVPNStatus(void *p)
     _tcsncpy(conn_name, c->config_file, _countof(conn_name));
     conn_name[_tcslen(conn_name) - _tcslen(o.ext_string) - 1] = _T('\0');
 
+    log_store_init(&c->log_store, max(o.log_lines, MAX_LOG_LINES));
+
     /* Create and Show Status Dialog */
     c->hwndStatus = CreateLocalizedDialogParam(ID_DLG_STATUS, StatusDialogFunc, (LPARAM) c);
     if (!c->hwndStatus)
@@ -2474,7 +2949,7 @@ ThreadOpenVPNStatus(void *p)
         /* kill daemon process if we started it */
         SetEvent(c->exit_event);
         Cleanup(c);
-        c->state = disconnected;
+        SetConnState(c, disconnected);
         return 1;
     }
 
@@ -2483,6 +2958,14 @@ ThreadOpenVPNStatus(void *p)
     SetDlgItemText(c->hwndStatus, ID_TXT_STATUS, LoadLocalizedString(IDS_NFO_STATE_CONNECTING));
     SetWindowText(c->hwndStatus, LoadLocalizedString(IDS_NFO_CONNECTION_XXX, conn_name));
 
+    if (from_queue)
+    {
+        WCHAR line[128];
+        _sntprintf_0(line, L"Started after %lu ms in the start queue, %d other connections starting",
+                     c->queue_wait, c->queue_starting);
+        WriteStatusLog(c, L"GUI> ", line, false);
+    }
+
     if (!OpenManagement(c))
     {
         MessageBoxExW(c->hwndStatus, L"Failed to open management", _T(PACKAGE_NAME),
@@ -2557,6 +3040,12 @@ ThreadOpenVPNStatus(void *p)
     /* release handles etc.*/
     Cleanup(c);
     c->hwndStatus = NULL;
+
+    /* the daemon may have been restarted: let the main window re-attach */
+    if ((c->flags & FLAG_DAEMON_PERSISTENT) && c->auto_connect && o.hWnd)
+    {
+        PostMessage(o.hWnd, WM_OVPN_PERSISTENT, 0, 0);
+    }
     return 0;
 }
 
@@ -2627,8 +3116,10 @@ PrepareStartJsonRequest(connection_t *c, wchar_t *exit_event_name)
     json_object_object_add(jobj, "config_dir", json_object_new_utf16_string(c->config_dir));
     json_object_object_add(jobj, "exit_event_name", json_object_new_utf16_string(exit_event_name));
     json_object_object_add(jobj, "management_password", json_object_new_string(c->manage.password));
-    json_object_object_add(jobj, "management_host", json_object_new_string(inet_ntoa(c->manage.skaddr.sin_addr)));
-    json_object_object_add(jobj, "management_port", json_object_new_int(ntohs(c->manage.skaddr.sin_port)));
+    /* the daemon is always given an ipv4 address, see SetManagementAddress() */
+    SOCKADDR_IN *addr = (SOCKADDR_IN *) &c->manage.skaddr;
+    json_object_object_add(jobj, "management_host", json_object_new_string(inet_ntoa(addr->sin_addr)));
+    json_object_object_add(jobj, "management_port", json_object_new_int(ntohs(addr->sin_port)));
     json_object_object_add(jobj, "log", json_object_new_utf16_string(c->log_path));
     json_object_object_add(jobj, "log-append", json_object_new_int(o.log_append));
 
@@ -2714,7 +3205,7 @@ StartOpenVPN(connection_t *c)
             }
             else
             {
-                c->state = disconnected;
+                SetConnState(c, disconnected);
             }
             TerminateThread(hThread, 1);
             return false;
@@ -2727,7 +3218,7 @@ StartOpenVPN(connection_t *c)
         return false;
     }
 
-    c->state = (c->state == suspended || c->state == detached) ? resuming : connecting;
+    SetConnState(c, (c->state == suspended || c->state == detached) ? resuming : connecting);
 
     /* Start the status dialog thread */
     ResumeThread(hThread);
@@ -2740,6 +3231,27 @@ StartOpenVPN(connection_t *c)
     return true;
 }
 
+/*
+ * Choose where openvpn.exe listens for the management connection:
+ * a free tcp port on localhost.
+ */
+static void
+SetManagementAddress(connection_t *c)
+{
+    SOCKADDR_IN *addr = (SOCKADDR_IN *) &c->manage.skaddr;
+
+    /* a previous run may have left an address parsed from the config in place */
+    if (addr->sin_family != AF_INET)
+    {
+        memset(&c->manage.skaddr, 0, sizeof(c->manage.skaddr));
+        addr->sin_family = AF_INET;
+        addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+        addr->sin_port = htons((unsigned short) (o.mgmt_port_offset + c->id));
+    }
+    c->manage.skaddr_len = sizeof(*addr);
+    find_free_tcp_port(addr);
+}
+
 /*
  * Launch an OpenVPN process
  */
@@ -2754,10 +3266,11 @@ LaunchOpenVPN(connection_t *c)
     DWORD written;
     BOOL retval = FALSE;
     DWORD passwd_len = 16; /* incuding NUL */
+    WCHAR mgmt_addr[64]; /* "host port" with an IPv4 or IPv6 host */
 
-    if (passwd_len > sizeof(c->manage.password))
+    if (passwd_len > MGMT_PASSWORD_SIZE)
     {
-        passwd_len = sizeof(c->manage.password);
+        passwd_len = MGMT_PASSWORD_SIZE;
     }
 
     RunPreconnectScript(c);
@@ -2772,19 +3285,26 @@ LaunchOpenVPN(connection_t *c)
     }
 
     /* Create a management interface password */
+    if (!GetManagementPassword(c))
+    {
+        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Out of memory for the management password of %ls",
+                      c->config_name);
+        CloseHandle(c->exit_event);
+        goto out;
+    }
     GetRandomPassword(c->manage.password, passwd_len - 1);
 
-    find_free_tcp_port(&c->manage.skaddr);
+    SetManagementAddress(c);
+    FormatManagementEndpoint(&c->manage.skaddr, mgmt_addr, _countof(mgmt_addr));
 
     /* Construct command line -- put log first */
     _sntprintf_0(cmdline, _T("openvpn --log%ls \"%ls\" --config \"%ls\" "
                              "--setenv IV_GUI_VER \"%hs %hs\" --setenv IV_SSO openurl,webauth,crtext --service %ls 0 --auth-retry interact "
-                             "--management %hs %hd stdin --management-query-passwords %ls"
+                             "--management %ls stdin --management-query-passwords %ls"
                              "--management-hold"),
                  (o.log_append ? _T("-append") : _T("")), c->log_path,
                  c->config_file, PACKAGE_NAME, PACKAGE_VERSION_RESOURCE_STR, exit_event_name,
-                 inet_ntoa(c->manage.skaddr.sin_addr), ntohs(c->manage.skaddr.sin_port),
-                 (o.proxy_source != config ? _T("--management-query-proxy ") : _T("")));
+                 mgmt_addr, (o.proxy_source != config ? _T("--management-query-proxy ") : _T("")));
 
     BOOL use_iservice = (o.iservice_admin && IsWindows7OrGreater()) || !IsUserAdmin();
     /* Try to open the service pipe */
@@ -43,6 +43,13 @@ typedef enum
 
 extern options_t o;
 
+/* Change notifications on the directories scanned by BuildFileList */
+static struct {
+    TCHAR path[MAX_PATH];
+    HANDLE handle;              /* NULL if the directory could not be watched */
+    bool used;                  /* scanned by the last BuildFileList */
+} dir_watch[3];
+
 static match_t
 match(const WIN32_FIND_DATA *find, const TCHAR *ext)
 {
@@ -83,14 +90,23 @@ CheckReadAccess(const TCHAR *dir, const TCHAR *file)
 static int
 ConfigAlreadyExists(TCHAR *newconfig)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    return name_index_find(&o.conn_by_file, newconfig) != NULL;
+}
+
+/* Set the log file of c to log_dir\<config_name>.log */
+static void
+SetLogPath(connection_t *c, const TCHAR *log_dir)
+{
+    size_t len = _tcslen(log_dir) + _tcslen(c->config_name) + 6; /* \ .log and nul */
+
+    free(c->log_path);
+    c->log_path = malloc(len * sizeof(*c->log_path));
+    if (!c->log_path)
     {
-        if (_tcsicmp(c->config_file, newconfig) == 0)
-        {
-            return true;
-        }
+        ErrorExit(1, L"Out of memory in AddConfigFileToList");
     }
-    return false;
+    _sntprintf(c->log_path, len, _T("%ls\\%ls.log"), log_dir, c->config_name);
+    c->log_path[len - 1] = _T('\0');
 }
 
 static void
@@ -115,22 +131,31 @@ AddConfigFileToList(int group, const TCHAR *filename, const TCHAR *config_dir)
 
     c->id = o.num_configs++;
     c->group = group;
+    InitConnState(c);
+
+    /* all configs in a directory share one copy of its path */
+    c->config_dir = name_index_intern(&o.config_dirs, config_dir);
+    if (!c->config_dir)
+    {
+        ErrorExit(1, L"Out of memory in AddConfigFileToList");
+    }
 
     _tcsncpy(c->config_file, filename, _countof(c->config_file) - 1);
-    _tcsncpy(c->config_dir, config_dir, _countof(c->config_dir) - 1);
     _tcsncpy(c->config_name, c->config_file, _countof(c->config_name) - 1);
     c->config_name[_tcslen(c->config_name) - _tcslen(o.ext_string) - 1] = _T('\0');
-    _sntprintf_0(c->log_path, _T("%ls\\%ls.log"), o.log_dir, c->config_name);
+    SetLogPath(c, o.log_dir);
 
     c->manage.sk = INVALID_SOCKET;
-    c->manage.skaddr.sin_family = AF_INET;
-    c->manage.skaddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    c->manage.skaddr.sin_port = htons(o.mgmt_port_offset + c->id);
+    SOCKADDR_IN *addr = (SOCKADDR_IN *) &c->manage.skaddr;
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr->sin_port = htons(o.mgmt_port_offset + c->id);
+    c->manage.skaddr_len = sizeof(*addr);
 
     if (wcsstr(config_dir, o.config_auto_dir))
     {
         c->flags |= FLAG_DAEMON_PERSISTENT;
-        _sntprintf_0(c->log_path, _T("%ls\\%ls.log"), o.global_log_dir, c->config_name);
+        SetLogPath(c, o.global_log_dir);
         /* set to auto-connect -- this attempts to attach to them on startup */
         if (o.enable_persistent == 2)
         {
@@ -168,6 +193,12 @@ AddConfigFileToList(int group, const TCHAR *filename, const TCHAR *config_dir)
     {
         DisablePopupMessages(c);
     }
+
+    if (!name_index_add(&o.conn_by_file, c->config_file, c)
+        || !name_index_add(&o.conn_by_name, c->config_name, c))
+    {
+        ErrorExit(1, L"Out of memory in AddConfigFileToList");
+    }
 }
 
 #define FLAG_WARN_DUPLICATES        (0x1)
@@ -285,23 +316,38 @@ ActivateConfigGroups(void)
     }
 }
 
+/* counters reported after each scan */
+typedef struct {
+    int dirs;                   /* directories enumerated */
+    int files;                  /* config files found */
+    int added;                  /* configs added to the list */
+    int duplicates;             /* configs ignored as already listed */
+} scan_stats_t;
+
 /* Scan for configs in config_dir recursing down up to recurse_depth.
  * Input: config_dir -- root of the directory to scan from
  *        group      -- the group into which add the configs to
  *        flags      -- enable warnings, use directory based
  *                      grouping of configs etc.
+ *        stats      -- counters to update
  * Currently configs in a directory are grouped together and group is
  * the id of the current group in the global group array |o.groups|
  * This may be recursively called until depth becomes 1 and each time
  * the group is changed to that of the directory being recursed into.
+ * The directory is enumerated once: subdirectories seen on the way are
+ * remembered and visited after all configs of this level are added.
  */
 static void
-BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
+BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags,
+               scan_stats_t *stats)
 {
     WIN32_FIND_DATA find_obj;
     HANDLE find_handle;
     TCHAR find_string[MAX_PATH];
     TCHAR subdir_name[MAX_PATH];
+    TCHAR **subdirs = NULL;
+    int num_subdirs = 0;
+    int max_subdirs = 0;
 
     _sntprintf_0(find_string, _T("%ls\\*"), config_dir);
     find_handle = FindFirstFile(find_string, &find_obj);
@@ -309,6 +355,7 @@ BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
     {
         return;
     }
+    stats->dirs++;
 
     /* Loop over each config file in config dir */
     do
@@ -316,8 +363,10 @@ BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
         match_t match_type = match(&find_obj, o.ext_string);
         if (match_type == match_file)
         {
+            stats->files++;
             if (ConfigAlreadyExists(find_obj.cFileName))
             {
+                stats->duplicates++;
                 if (flags & FLAG_WARN_DUPLICATES)
                 {
                     ShowLocalizedMsg(IDS_ERR_CONFIG_EXIST, find_obj.cFileName);
@@ -328,42 +377,44 @@ BuildFileList0(const TCHAR *config_dir, int recurse_depth, int group, int flags)
             if (CheckReadAccess(config_dir, find_obj.cFileName))
             {
                 AddConfigFileToList(group, find_obj.cFileName, config_dir);
+                stats->added++;
             }
         }
-    } while (FindNextFile(find_handle, &find_obj));
-
-    FindClose(find_handle);
-
-    /* optionally loop over each subdir */
-    if (recurse_depth < 1)
-    {
-        return;
-    }
-
-    find_handle = FindFirstFile(find_string, &find_obj);
-    if (find_handle == INVALID_HANDLE_VALUE)
-    {
-        return;
-    }
-
-    do
-    {
-        match_t match_type = match(&find_obj, o.ext_string);
-        if (match_type == match_dir)
+        else if (match_type == match_dir && recurse_depth > 0
+                 && wcscmp(find_obj.cFileName, _T("."))
+                 && wcscmp(find_obj.cFileName, _T("..")))
         {
-            if (wcscmp(find_obj.cFileName, _T("."))
-                &&  wcscmp(find_obj.cFileName, _T("..")))
+            if (num_subdirs == max_subdirs)
             {
-                /* recurse into subdirectory */
-                _sntprintf_0(subdir_name, _T("%ls\\%ls"), config_dir, find_obj.cFileName);
-                int sub_group = NewConfigGroup(find_obj.cFileName, group, flags);
-
-                BuildFileList0(subdir_name, recurse_depth - 1, sub_group, flags);
+                max_subdirs += 16;
+                TCHAR **tmp = realloc(subdirs, sizeof(*subdirs)*max_subdirs);
+                if (!tmp)
+                {
+                    ErrorExit(1, L"Out of memory while scanning config directories");
+                }
+                subdirs = tmp;
             }
+            subdirs[num_subdirs] = _tcsdup(find_obj.cFileName);
+            if (!subdirs[num_subdirs])
+            {
+                ErrorExit(1, L"Out of memory while scanning config directories");
+            }
+            num_subdirs++;
         }
     } while (FindNextFile(find_handle, &find_obj));
 
     FindClose(find_handle);
+
+    /* recurse into subdirectories in the order they were found */
+    for (int i = 0; i < num_subdirs; i++)
+    {
+        _sntprintf_0(subdir_name, _T("%ls\\%ls"), config_dir, subdirs[i]);
+        int sub_group = NewConfigGroup(subdirs[i], group, flags);
+
+        BuildFileList0(subdir_name, recurse_depth - 1, sub_group, flags, stats);
+        free(subdirs[i]);
+    }
+    free(subdirs);
 }
 
 /*
@@ -428,6 +479,56 @@ IsSamePath(const wchar_t *path1, const wchar_t *path2)
     return ret;
 }
 
+/*
+ * Arm a change notification for the config directory about to be scanned
+ * as the idx'th one. Called before the scan so that changes made during
+ * the scan are reported by ConfigDirsChanged() afterwards.
+ */
+static void
+WatchConfigDir(int idx, const TCHAR *path)
+{
+    HANDLE h = dir_watch[idx].handle;
+
+    if (h && _tcscmp(dir_watch[idx].path, path) == 0)
+    {
+        if (WaitForSingleObject(h, 0) == WAIT_OBJECT_0 && !FindNextChangeNotification(h))
+        {
+            FindCloseChangeNotification(h);
+            dir_watch[idx].handle = NULL;
+        }
+    }
+    else
+    {
+        if (h)
+        {
+            FindCloseChangeNotification(h);
+        }
+        _tcsncpy(dir_watch[idx].path, path, _countof(dir_watch[idx].path) - 1);
+        h = FindFirstChangeNotification(path, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME
+                                        |FILE_NOTIFY_CHANGE_DIR_NAME|FILE_NOTIFY_CHANGE_SECURITY);
+        dir_watch[idx].handle = (h == INVALID_HANDLE_VALUE) ? NULL : h;
+    }
+    dir_watch[idx].used = true;
+}
+
+/*
+ * Return true if a rescan by BuildFileList may find new configs: some
+ * directory it scanned has changed since, or could not be watched.
+ */
+bool
+ConfigDirsChanged(void)
+{
+    for (int i = 0; i < _countof(dir_watch); i++)
+    {
+        if (dir_watch[i].used
+            && (!dir_watch[i].handle || WaitForSingleObject(dir_watch[i].handle, 0) != WAIT_TIMEOUT))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void
 BuildFileList()
 {
@@ -435,6 +536,8 @@ BuildFileList()
     int recurse_depth = 20; /* maximum number of levels below config_dir to recurse into */
     int flags = 0;
     static int root_gp, system_gp, persistent_gp;
+    scan_stats_t stats = {0};
+    ULONGLONG start = GetTickCount64();
 
     if (o.silent_connection)
     {
@@ -467,11 +570,18 @@ BuildFileList()
         flags |= FLAG_WARN_DUPLICATES | FLAG_WARN_MAX_CONFIGS;
     }
 
-    BuildFileList0(o.config_dir, recurse_depth, root_gp, flags);
+    for (int i = 0; i < _countof(dir_watch); i++)
+    {
+        dir_watch[i].used = false;
+    }
+
+    WatchConfigDir(0, o.config_dir);
+    BuildFileList0(o.config_dir, recurse_depth, root_gp, flags, &stats);
 
     if (!IsSamePath(o.global_config_dir, o.config_dir))
     {
-        BuildFileList0(o.global_config_dir, recurse_depth, system_gp, flags);
+        WatchConfigDir(1, o.global_config_dir);
+        BuildFileList0(o.global_config_dir, recurse_depth, system_gp, flags, &stats);
     }
 
     if (o.service_state == service_connected
@@ -479,7 +589,8 @@ BuildFileList()
     {
         if (!IsSamePath(o.config_auto_dir, o.config_dir))
         {
-            BuildFileList0(o.config_auto_dir, recurse_depth, persistent_gp, flags);
+            WatchConfigDir(2, o.config_auto_dir);
+            BuildFileList0(o.config_auto_dir, recurse_depth, persistent_gp, flags, &stats);
         }
     }
 
@@ -490,6 +601,10 @@ BuildFileList()
 
     ActivateConfigGroups();
 
+    PrintDebug(L"Config scan: %d dirs, %d configs found, %d added, %d duplicates, %llu ms",
+               stats.dirs, stats.files, stats.added, stats.duplicates, GetTickCount64() - start);
+    PrintDebug(L"%d configs share %d config dir strings", o.num_configs, (int) o.config_dirs.count);
+
     issue_warnings = false;
 }
 
@@ -500,8 +615,25 @@ FreeConfigList(options_t *o)
     for (connection_t *c = o->chead; c; c = next)
     {
         next = c->next;
+        free(c->log_path);
+        free(c->throughput);
+        free(c->latency);
         free(c);
     }
+    name_index_clear(&o->conn_by_file);
+    name_index_clear(&o->conn_by_name);
+    name_index_free_interned(&o->config_dirs);
+    CLEAR(o->conn_in_state);
+    CLEAR(o->count_in_state);
+
+    for (int i = 0; i < _countof(dir_watch); i++)
+    {
+        if (dir_watch[i].handle)
+        {
+            FindCloseChangeNotification(dir_watch[i].handle);
+        }
+        CLEAR(dir_watch[i]);
+    }
     free(o->groups);
     o->groups = NULL;
     o->num_configs = 0;
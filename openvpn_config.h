@@ -26,6 +26,8 @@
 
 void BuildFileList(void);
 
+bool ConfigDirsChanged(void);
+
 bool ConfigFileOptionExist(int, const char *);
 
 void FreeConfigList(options_t *o);
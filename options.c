@@ -273,6 +273,18 @@ add_option(options_t *options, int i, TCHAR **p)
             options->action = WM_OVPN_SHOWSTATUS;
             options->action_arg = p[2];
         }
+        else if (streq(p[1], _T("export_throughput")) && p[2])
+        {
+            ++i;
+            options->action = WM_OVPN_THROUGHPUT;
+            options->action_arg = p[2];
+        }
+        else if (streq(p[1], _T("dump_latency")) && p[2])
+        {
+            ++i;
+            options->action = WM_OVPN_LATENCY;
+            options->action_arg = p[2];
+        }
         else if (streq(p[1], L"import") && p[2])
         {
             ++i;
@@ -325,6 +337,45 @@ add_option(options_t *options, int i, TCHAR **p)
             options->mgmt_port_offset = tmp;
         }
     }
+    else if (streq(p[0], _T("management_pipeline")) && p[1])
+    {
+        ++i;
+        int tmp = _wtoi(p[1]);
+        if (tmp < 1 || tmp > 16)
+        {
+            MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Specified management pipeline depth is not valid (must be in the range 1 to 16). Ignored.");
+        }
+        else
+        {
+            options->mgmt_pipeline = tmp;
+        }
+    }
+    else if (streq(p[0], _T("start_concurrency")) && p[1])
+    {
+        ++i;
+        int tmp = _wtoi(p[1]);
+        if (tmp < 0 || tmp > 64)
+        {
+            MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Specified start concurrency is not valid (must be in the range 0 to 64). Ignored.");
+        }
+        else
+        {
+            options->start_concurrency = tmp;
+        }
+    }
+    else if (streq(p[0], _T("log_lines")) && p[1])
+    {
+        ++i;
+        int tmp = _wtoi(p[1]);
+        if (tmp < MAX_LOG_LINES || tmp > 100000)
+        {
+            MsgToEventLog(EVENTLOG_ERROR_TYPE, L"Specified number of log lines is not valid (must be in the range 500 to 100000). Ignored.");
+        }
+        else
+        {
+            options->log_lines = tmp;
+        }
+    }
 
     else
     {
@@ -473,44 +524,81 @@ ProcessCommandLine(options_t *options, TCHAR *command_line)
 int
 CountConnState(conn_state_t check)
 {
-    int count = 0;
+    return o.count_in_state[check];
+}
 
-    for (connection_t *c = o.chead; c; c = c->next)
+/* Add c to the list of its current state. Call with state_lock held */
+static void
+LinkConnState(connection_t *c)
+{
+    c->state_prev = NULL;
+    c->state_next = o.conn_in_state[c->state];
+    if (c->state_next)
     {
-        if (c->state == check)
-        {
-            ++count;
-        }
+        c->state_next->state_prev = c;
     }
+    o.conn_in_state[c->state] = c;
+    o.count_in_state[c->state]++;
+}
 
-    return count;
+/* Remove c from the list of its current state. Call with state_lock held */
+static void
+UnlinkConnState(connection_t *c)
+{
+    if (c->state_prev)
+    {
+        c->state_prev->state_next = c->state_next;
+    }
+    else
+    {
+        o.conn_in_state[c->state] = c->state_next;
+    }
+    if (c->state_next)
+    {
+        c->state_next->state_prev = c->state_prev;
+    }
+    c->state_next = c->state_prev = NULL;
+    o.count_in_state[c->state]--;
 }
 
-connection_t *
-GetConnByManagement(SOCKET sk)
+/* Register a new connection in its initial state */
+void
+InitConnState(connection_t *c)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    AcquireSRWLockExclusive(&o.state_lock);
+    LinkConnState(c);
+    ReleaseSRWLockExclusive(&o.state_lock);
+}
+
+/*
+ * Change the state of a connection. All state changes go through here
+ * so that the count and list of connections in each state stay current.
+ */
+void
+SetConnState(connection_t *c, conn_state_t state)
+{
+    AcquireSRWLockExclusive(&o.state_lock);
+    if (c->state != state)
     {
-        if (c->manage.sk == sk)
-        {
-            return c;
-        }
+        UnlinkConnState(c);
+        c->state = state;
+        LinkConnState(c);
     }
-    return NULL;
+    ReleaseSRWLockExclusive(&o.state_lock);
 }
 
 connection_t *
 GetConnByName(const WCHAR *name)
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    connection_t *by_file = name_index_find(&o.conn_by_file, name);
+    connection_t *by_name = name_index_find(&o.conn_by_name, name);
+
+    /* if both match, the first one in the list wins */
+    if (by_file && by_name)
     {
-        if (wcsicmp(c->config_file, name) == 0
-            || wcsicmp(c->config_name, name) == 0)
-        {
-            return c;
-        }
+        return (by_file->id < by_name->id) ? by_file : by_name;
     }
-    return NULL;
+    return by_file ? by_file : by_name;
 }
 
 static BOOL
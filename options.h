@@ -35,6 +35,10 @@ typedef struct connection connection_t;
 #include "manage.h"
 #include "echo.h"
 #include "pkcs11.h"
+#include "log_store.h"
+#include "name_index.h"
+#include "throughput.h"
+#include "latency.h"
 
 #define MAX_NAME (UNLEN + 1)
 
@@ -77,12 +81,16 @@ typedef enum {
     detached,
 } conn_state_t;
 
+#define CONN_STATE_COUNT (detached + 1)
+
 /* Interactive Service IO parameters */
+#define SERVICE_IO_READBUF_LEN 512
+
 typedef struct {
     OVERLAPPED o; /* This has to be the first element */
     HANDLE pipe;
     HANDLE hEvent;
-    WCHAR readbuf[512];
+    WCHAR *readbuf; /* SERVICE_IO_READBUF_LEN chars allocated in InitServiceIO */
 } service_io_t;
 
 #define FLAG_ALLOW_CHANGE_PASSPHRASE (1<<1)
@@ -117,7 +125,8 @@ typedef struct config_group {
     BOOL active;                 /* Displayed in the menu if true -- used to prune empty groups */
     int children;                /* Number of children groups and configs */
     int pos;                     /* Index within the parent group -- used for rendering */
-    HMENU menu;                  /* Handle to menu entry for this group */
+    HMENU menu;                  /* Handle to menu entry for this group -- created on first display */
+    unsigned int menu_gen;       /* Menu generation the items of menu were added for */
 } config_group_t;
 
 /* short hand for pointer to the group a config belongs to */
@@ -129,8 +138,8 @@ typedef struct config_group {
 struct connection {
     TCHAR config_file[MAX_PATH];    /* Name of the config file */
     TCHAR config_name[MAX_PATH];    /* Name of the connection */
-    TCHAR config_dir[MAX_PATH];     /* Path to this configs dir */
-    TCHAR log_path[MAX_PATH];       /* Path to Logfile */
+    const TCHAR *config_dir;        /* Path to this configs dir -- shared, see o.config_dirs */
+    TCHAR *log_path;                /* Path to Logfile */
     TCHAR ip[16];                   /* Assigned IP address for this connection */
     TCHAR ipv6[46];                 /* Assigned IPv6 address */
     BOOL auto_connect;              /* AutoConnect at startup id TRUE */
@@ -144,12 +153,20 @@ struct connection {
 
     struct {
         SOCKET sk;
-        SOCKADDR_IN skaddr;
+        SOCKADDR_STORAGE skaddr;    /* IPv4 or IPv6 address */
+        int skaddr_len;             /* length of the address in skaddr */
         time_t timeout;
-        char password[4096];        /* match with largest possible passwd in openvpn.exe */
-        char *saved_data;
-        size_t saved_size;
+        int retries;                /* failed connect attempts since OpenManagement() */
+        DWORD retry_delay;          /* current backoff delay in ms */
+        DWORD retry_start;          /* tick count of the first failed attempt */
+        unsigned long retries_total; /* failed connect attempts over all runs */
+        DWORD ready_start;          /* tick count when >INFO was received */
+        BOOL probe_lost;            /* the command sent on >INFO was given up */
+        char *password;             /* allocated on start, see GetManagementPassword() */
+        mgmt_rbuf_t rbuf;
         mgmt_cmd_t *cmd_queue;
+        mgmt_cmd_t *cmd_free;       /* unused queue nodes kept for reuse */
+        int cmd_free_count;
         DWORD connected;             /* 1: management interface connected, 2: connected and ready */
     } manage;
 
@@ -163,12 +180,27 @@ struct connection {
     char *dynamic_cr;              /* Pointer to buffer for dynamic challenge string received */
     unsigned long long int bytes_in;
     unsigned long long int bytes_out;
+    int bytecount_interval;        /* Seconds between bytecount reports requested, 0 if none */
+    throughput_t *throughput;      /* Traffic history, allocated on the first bytecount report */
+    latency_stats_t *latency;      /* Connect time histograms, loaded on the first state change */
+    latency_timer_t latency_timer; /* Timing of the connect attempt in progress */
+    BOOL from_queue;               /* started by RunStartQueue(), timing not yet logged */
+    DWORD queue_wait;              /* msec spent in the start queue */
+    int queue_starting;            /* other connections starting when it left the queue */
     struct env_item *es;           /* Pointer to the head of config-specific env variables list */
     struct echo_msg echo_msg;      /* Message echo-ed from server or client config and related data */
     struct pkcs11_list pkcs11_list;
+    log_store_t log_store;         /* recent log lines of this connection */
+    unsigned long long log_shown;  /* first log record shown in the status window */
+    unsigned long long log_flushed; /* log records from here on are not yet shown */
+    log_writer_t log_writer;       /* GUI lines not yet written to the log file */
+    HWND hwndLog;                  /* log control, created when the status window is first shown */
+    BOOL log_timer;                /* IDT_LOG_TIMER is running */
     char daemon_state[20];         /* state of openvpn.ex: WAIT, AUTH, GET_CONFIG etc.. */
     int id;                        /* index of config -- treat as immutable once assigned */
     connection_t *next;
+    connection_t *state_next;       /* Connections in the same state, see SetConnState() */
+    connection_t *state_prev;
 };
 
 /* All options used within OpenVPN GUI */
@@ -179,8 +211,14 @@ typedef struct {
     /* Connection parameters */
     connection_t *chead;              /* Head of connection list */
     connection_t *ctail;              /* Tail of connection list */
+    name_index_t conn_by_file;        /* Index of connections by config_file */
+    name_index_t conn_by_name;        /* Index of connections by config_name */
+    name_index_t config_dirs;         /* Interned config directories of connections */
     config_group_t *groups;           /* Array of nodes defining the config groups tree */
     int num_configs;                  /* Number of configs */
+    SRWLOCK state_lock;               /* Guards the per-state lists below */
+    connection_t *conn_in_state[CONN_STATE_COUNT]; /* Connections by state */
+    int count_in_state[CONN_STATE_COUNT];          /* Length of each of these lists */
     int num_auto_connect;             /* Number of auto-connect configs */
     int num_groups;                   /* Number of config groups */
     int max_configs;                  /* Current capacity of conn array */
@@ -225,6 +263,9 @@ typedef struct {
     DWORD disable_popup_messages;       /* set nonzero to suppress all echo msg messages */
     DWORD popup_mute_interval;          /* Interval in hours to suppress repeated echo messages */
     DWORD mgmt_port_offset;             /* management interface port = this offset + index of connection profile */
+    DWORD mgmt_pipeline;                /* max number of management commands awaiting response */
+    DWORD start_concurrency;            /* max connections auto-started or resumed at a time, 0 = no limit */
+    DWORD log_lines;                    /* number of log lines kept per connection */
 
     DWORD ovpn_engine;                  /* 0 - openvpn2, 1 - openvpn3 */
     DWORD enable_persistent;            /* 0 - disabled, 1 - enabled, 2 - enabled & auto attach */
@@ -256,7 +297,10 @@ void ProcessCommandLine(options_t *, TCHAR *);
 
 int CountConnState(conn_state_t);
 
-connection_t *GetConnByManagement(SOCKET);
+void InitConnState(connection_t *c);
+
+void SetConnState(connection_t *c, conn_state_t state);
+
 
 connection_t *GetConnByName(const WCHAR *config_name);
 
@@ -65,6 +65,9 @@ struct regkey_int {
     {L"popup_mute_interval", &o.popup_mute_interval, 24},
     {L"disable_popup_messages", &o.disable_popup_messages, 0},
     {L"management_port_offset", &o.mgmt_port_offset, 25340},
+    {L"management_pipeline", &o.mgmt_pipeline, 1},
+    {L"start_concurrency", &o.start_concurrency, 4},
+    {L"log_lines", &o.log_lines, 5000},
     {L"enable_peristent_connections", &o.enable_persistent, 2},
     {L"enable_auto_restart", &o.enable_auto_restart, 1},
     {L"auth_pass_concat_otp", &o.auth_pass_concat_otp, 0},
@@ -227,6 +230,22 @@ GetRegistryKeys()
     {
         o.mgmt_port_offset = 25340;
     }
+    if (o.mgmt_pipeline < 1 || o.mgmt_pipeline > 16)
+    {
+        o.mgmt_pipeline = 1;
+    }
+    if (o.start_concurrency > 64)
+    {
+        o.start_concurrency = 4;
+    }
+    if (o.log_lines < MAX_LOG_LINES)
+    {
+        o.log_lines = MAX_LOG_LINES;
+    }
+    else if (o.log_lines > 100000)
+    {
+        o.log_lines = 100000;
+    }
 
     /* Read group policy setting for password reveal */
     status = RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Policies\\Microsoft\\Windows\\CredUI", 0, KEY_READ, &regkey);
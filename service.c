@@ -165,6 +165,81 @@ out:
     }
 }
 
+static VOID CALLBACK
+OnServiceNotify(PVOID param)
+{
+    SERVICE_NOTIFYW *notify = param;
+    PostMessage((HWND) notify->pContext, WM_OVPN_PERSISTENT, 0, 0);
+}
+
+static DWORD WINAPI
+ServiceWatchThread(LPVOID param)
+{
+    HWND hwnd = param;
+    SC_HANDLE schSCManager = NULL;
+    SC_HANDLE schService = NULL;
+    SERVICE_STATUS ssStatus;
+    SERVICE_NOTIFYW notify = {
+        .dwVersion = SERVICE_NOTIFY_STATUS_CHANGE,
+        .pfnNotifyCallback = OnServiceNotify,
+        .pContext = hwnd
+    };
+
+    schSCManager = OpenSCManager(NULL, NULL, SC_MANAGER_CONNECT);
+    if (schSCManager)
+    {
+        schService = OpenService(schSCManager, _T("OpenVPNService"), SERVICE_QUERY_STATUS);
+    }
+    if (!schService || !QueryServiceStatus(schService, &ssStatus))
+    {
+        goto out;
+    }
+
+    while (true)
+    {
+        /* a state in the mask is reported at once: ask for the opposite of the current one */
+        DWORD mask = (ssStatus.dwCurrentState == SERVICE_RUNNING)
+                     ? (SERVICE_NOTIFY_STOP_PENDING | SERVICE_NOTIFY_STOPPED)
+                     : SERVICE_NOTIFY_RUNNING;
+        if (NotifyServiceStatusChangeW(schService, mask, &notify) != ERROR_SUCCESS)
+        {
+            break;
+        }
+        /* the callback runs as an APC of this thread */
+        SleepEx(INFINITE, TRUE);
+        if (notify.dwNotificationStatus != ERROR_SUCCESS)
+        {
+            break;
+        }
+        ssStatus.dwCurrentState = notify.ServiceStatus.dwCurrentState;
+    }
+
+out:
+    PrintDebug(L"Not watching the OpenVPN service for state changes");
+    PostMessage(hwnd, WM_OVPN_PERSISTENT, 1, 0);
+    if (schService)
+    {
+        CloseServiceHandle(schService);
+    }
+    if (schSCManager)
+    {
+        CloseServiceHandle(schSCManager);
+    }
+    return 0;
+}
+
+BOOL
+WatchServiceStatus(HWND hwnd)
+{
+    HANDLE thread = CreateThread(NULL, 0, ServiceWatchThread, hwnd, 0, NULL);
+    if (!thread)
+    {
+        return FALSE;
+    }
+    CloseHandle(thread);
+    return TRUE;
+}
+
 /* Attempt to start OpenVPN Automatc Service */
 void
 StartAutomaticService(void)
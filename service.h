@@ -21,6 +21,14 @@
 
 VOID CheckServiceStatus();
 
+/*
+ * Watch the OpenVPN service from a background thread and post
+ * WM_OVPN_PERSISTENT to hwnd when it starts or stops. If watching
+ * ends, the message is posted once more with wParam = 1.
+ * Returns FALSE if the thread could not be started.
+ */
+BOOL WatchServiceStatus(HWND hwnd);
+
 BOOL CheckIServiceStatus(BOOL warn);
 
 /* Attempt to start OpenVPN Automatc Service */
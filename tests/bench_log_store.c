@@ -0,0 +1,58 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Time adding log lines to a full store, each one evicting the oldest.
+ * Usage: bench_log_store [max_lines [lines]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wchar.h>
+#include "log_store.h"
+
+int
+main(int argc, char *argv[])
+{
+    size_t max_lines = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000;
+    long lines = argc > 2 ? strtol(argv[2], NULL, 10) : 2000000;
+    log_store_t ls;
+    wchar_t message[128];
+    clock_t start;
+    long i;
+
+    log_store_init(&ls, max_lines);
+    start = clock();
+    for (i = 0; i < lines; i++)
+    {
+        swprintf(message, 128, L"TCP/UDP: Preserving recently used remote address, line %ld\r\n", i);
+        if (!log_store_append(&ls, i, log_class_normal, 0, L"Mon Jan  1 00:00:00 2024 ", NULL, message))
+        {
+            fprintf(stderr, "out of memory after %ld lines\n", i);
+            return 1;
+        }
+    }
+    double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%ld lines into a store of %zu: %.3f s, %.0f ns per line, %zu lines kept\n",
+           lines, max_lines, secs, secs * 1e9 / lines, ls.count);
+    log_store_free(&ls);
+    return 0;
+}
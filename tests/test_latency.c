@@ -0,0 +1,166 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* included to reach the static bucket functions */
+#include "latency.c"
+#include "test.h"
+
+/* every value falls in the bucket whose upper end is the first not below it */
+static void
+test_buckets(void)
+{
+    unsigned long long v;
+    int i;
+
+    for (v = 0; v < LATENCY_LINEAR; v++)
+    {
+        CHECK(bucket_index(v) == (int) v);
+        CHECK(bucket_upper((int) v) == v);
+    }
+    for (i = 1; i < LATENCY_BUCKETS; i++)
+    {
+        CHECK(bucket_upper(i) > bucket_upper(i - 1));
+    }
+    for (v = 1; v < (1ULL << 24); v += v / 64 + 1)
+    {
+        i = bucket_index(v);
+        CHECK(v <= bucket_upper(i));
+        CHECK(i == 0 || v > bucket_upper(i - 1));
+        /* within 12.5% */
+        CHECK(bucket_upper(i) - v <= v / 8);
+    }
+    CHECK(bucket_upper(LATENCY_BUCKETS - 1) == (1ULL << 24) - 1);
+    CHECK(bucket_index(1ULL << 24) == LATENCY_BUCKETS - 1);
+    CHECK(bucket_index(~0ULL) == LATENCY_BUCKETS - 1);
+}
+
+static void
+test_percentile(void)
+{
+    latency_hist_t h;
+    unsigned long long v;
+
+    memset(&h, 0, sizeof(h));
+    CHECK(latency_percentile(&h, 0.5) == 0);
+
+    for (v = 1; v <= 100; v++)
+    {
+        latency_add(&h, v);
+    }
+    CHECK(latency_count(&h) == 100);
+    CHECK(latency_percentile(&h, 0.01) == 1);
+    CHECK(latency_percentile(&h, 0.10) == 10);
+    CHECK(latency_percentile(&h, 0.50) == 51);  /* 50 is in 48..51 */
+    CHECK(latency_percentile(&h, 0.99) == 103); /* 99 is in 96..103 */
+    CHECK(latency_percentile(&h, 1.0) == 103);
+}
+
+/* value of the only sample in a phase, to bucket precision */
+static unsigned long long
+sample(const latency_stats_t *ls, latency_phase_t phase)
+{
+    return latency_count(&ls->phase[phase]) == 1 ? latency_percentile(&ls->phase[phase], 1.0) : 0;
+}
+
+static void
+test_attempt(void)
+{
+    latency_stats_t ls;
+    latency_timer_t lt;
+
+    latency_stats_init(&ls);
+    latency_timer_reset(&lt);
+
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTING", 1000));
+    CHECK(!latency_state_change(&ls, &lt, "RESOLVE", 1010));
+    CHECK(!latency_state_change(&ls, &lt, "WAIT", 1030));
+    CHECK(!latency_state_change(&ls, &lt, "AUTH", 1100));
+    CHECK(!latency_state_change(&ls, &lt, "AUTH_PENDING", 1150));
+    CHECK(!latency_state_change(&ls, &lt, "GET_CONFIG", 1400));
+    CHECK(!latency_state_change(&ls, &lt, "ASSIGN_IP", 1410));
+    CHECK(!latency_state_change(&ls, &lt, "ADD_ROUTES", 1412));
+    CHECK(latency_state_change(&ls, &lt, "CONNECTED", 1500));
+
+    CHECK(sample(&ls, latency_connecting) == 10);
+    CHECK(sample(&ls, latency_resolve) == 21);      /* 20 is in 20..21 */
+    CHECK(sample(&ls, latency_wait) == 71);         /* 70 is in 64..71 */
+    CHECK(sample(&ls, latency_auth) == 319);        /* AUTH_PENDING included: 300 in 288..319 */
+    CHECK(sample(&ls, latency_get_config) == 10);
+    CHECK(sample(&ls, latency_assign_ip) == 2);
+    CHECK(sample(&ls, latency_add_routes) == 95);   /* 88 is in 88..95 */
+    CHECK(sample(&ls, latency_total) == 511);       /* 500 is in 480..511 */
+    CHECK(latency_count(&ls.phase[latency_tcp_connect]) == 0);
+
+    /* the connected state is not timed */
+    CHECK(!latency_state_change(&ls, &lt, "RECONNECTING", 9000));
+    CHECK(sample(&ls, latency_connecting) == 10);
+}
+
+static void
+test_attempt_end(void)
+{
+    latency_stats_t ls;
+    latency_timer_t lt;
+
+    latency_stats_init(&ls);
+    latency_timer_reset(&lt);
+
+    /* unknown states neither end the attempt nor the phase */
+    CHECK(!latency_state_change(&ls, &lt, "RECONNECTING", 0));
+    CHECK(!latency_state_change(&ls, &lt, "SOMETHING_NEW", 5));
+    CHECK(!latency_state_change(&ls, &lt, "WAIT", 12));
+    CHECK(latency_state_change(&ls, &lt, "CONNECTED", 20));
+    CHECK(sample(&ls, latency_connecting) == 12);
+    CHECK(sample(&ls, latency_wait) == 8);
+    CHECK(sample(&ls, latency_total) == 21);
+
+    /* EXITING abandons the attempt: its phase counts, the total does not */
+    latency_stats_init(&ls);
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTING", 100));
+    CHECK(!latency_state_change(&ls, &lt, "WAIT", 101));
+    CHECK(!latency_state_change(&ls, &lt, "EXITING", 104));
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTED", 110));
+    CHECK(sample(&ls, latency_wait) == 3);
+    CHECK(latency_count(&ls.phase[latency_total]) == 0);
+
+    /* CONNECTED without an attempt seen from its start */
+    latency_stats_init(&ls);
+    latency_timer_reset(&lt);
+    CHECK(!latency_state_change(&ls, &lt, "AUTH", 0));
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTED", 10));
+    CHECK(latency_count(&ls.phase[latency_auth]) == 0);
+    CHECK(latency_count(&ls.phase[latency_total]) == 0);
+
+    /* a repeated CONNECTING restarts the attempt */
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTING", 100));
+    CHECK(!latency_state_change(&ls, &lt, "CONNECTING", 107));
+    CHECK(latency_state_change(&ls, &lt, "CONNECTED", 110));
+    CHECK(latency_count(&ls.phase[latency_connecting]) == 2);
+    CHECK(sample(&ls, latency_total) == 3);
+}
+
+int
+main(void)
+{
+    test_buckets();
+    test_percentile();
+    test_attempt();
+    test_attempt_end();
+    return test_failures != 0;
+}
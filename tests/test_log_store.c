@@ -0,0 +1,193 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "log_store.h"
+#include "test.h"
+
+/* the text of record seq equals expect followed by a newline */
+static int
+record_is(const log_store_t *ls, unsigned long long seq, const wchar_t *expect)
+{
+    const log_record_t *rec = log_store_get(ls, seq);
+    size_t len = wcslen(expect);
+
+    return rec && rec->len == len + 1
+           && wmemcmp(ls->text + rec->offset, expect, len) == 0
+           && ls->text[rec->offset + len] == L'\n';
+}
+
+/* records wrap around in the ring once max_lines is reached */
+static void
+test_line_eviction(void)
+{
+    log_store_t ls;
+    wchar_t line[32];
+    unsigned long long seq;
+    int i;
+
+    log_store_init(&ls, 100);
+    for (i = 0; i < 250; i++)
+    {
+        swprintf(line, 32, L"line %d", i);
+        CHECK(log_store_append(&ls, i, log_class_normal, 0, NULL, NULL, line));
+    }
+
+    CHECK(ls.count == 100);
+    CHECK(ls.rec_cap == 100);
+    CHECK(ls.first_seq == 150);
+    CHECK(log_store_end(&ls) == 250);
+    CHECK(log_store_get(&ls, 149) == NULL);
+    CHECK(log_store_get(&ls, 250) == NULL);
+    for (seq = 150; seq < 250; seq++)
+    {
+        swprintf(line, 32, L"line %d", (int) seq);
+        CHECK(record_is(&ls, seq, line));
+        CHECK(log_store_get(&ls, seq)->timestamp == (time_t) seq);
+    }
+    log_store_free(&ls);
+}
+
+/* long lines evict old ones once the text ring is full and wrap around in it */
+static void
+test_text_wrap_around(void)
+{
+    log_store_t ls;
+    wchar_t *line = malloc(1001 * sizeof(*line));
+    unsigned long long seq;
+    int i, wrapped = 0;
+
+    log_store_init(&ls, 1000);
+    for (i = 0; i < 500; i++)
+    {
+        wmemset(line, L'a' + i % 26, 1000);
+        line[1000] = L'\0';
+        size_t tail = ls.text_tail;
+        CHECK(log_store_append(&ls, i, log_class_normal, 0, NULL, NULL, line));
+        if (log_store_get(&ls, i)->offset < tail)
+        {
+            wrapped++;
+        }
+    }
+
+    CHECK(wrapped > 0);
+    CHECK(ls.text_size == ls.max_chars + 1);
+    CHECK(ls.count < 500);
+    CHECK(ls.count * 1001 <= ls.max_chars);
+    CHECK(log_store_end(&ls) == 500);
+    for (seq = ls.first_seq; seq < log_store_end(&ls); seq++)
+    {
+        wmemset(line, L'a' + seq % 26, 1000);
+        CHECK(record_is(&ls, seq, line));
+    }
+    free(line);
+    log_store_free(&ls);
+}
+
+static void
+test_crlf_collapse(void)
+{
+    log_store_t ls;
+
+    log_store_init(&ls, 10);
+    CHECK(log_store_append(&ls, 0, log_class_normal, 0, L"a\r\n", L"b", NULL));
+    CHECK(log_store_append(&ls, 0, log_class_normal, 0, NULL, L"c\r", NULL));
+    CHECK(log_store_append(&ls, 0, log_class_normal, 0, NULL, NULL, L"x\ry\r\n\r\nz"));
+    CHECK(log_store_append(&ls, 0, log_class_normal, 0, NULL, NULL, L"\r"));
+
+    CHECK(record_is(&ls, 0, L"a\nb"));
+    CHECK(record_is(&ls, 1, L"c"));     /* the trailing CR goes with the newline */
+    CHECK(record_is(&ls, 2, L"x\ry\n\nz"));
+    CHECK(record_is(&ls, 3, L""));
+    log_store_free(&ls);
+}
+
+static void
+test_limits(void)
+{
+    log_store_t ls;
+    wchar_t *line = malloc((LOG_STORE_MAX_LINE + 2) * sizeof(*line));
+
+    log_store_init(&ls, 10);
+    CHECK(log_store_reserve(&ls, LOG_STORE_MAX_LINE + 1) == NULL);
+
+    wmemset(line, L'x', LOG_STORE_MAX_LINE + 1);
+    line[LOG_STORE_MAX_LINE + 1] = L'\0';
+    CHECK(log_store_append(&ls, 0, log_class_error, 3, L"12:00 ", NULL, line));
+    CHECK(log_store_get(&ls, 0)->len == LOG_STORE_MAX_LINE + 1);
+    CHECK(log_store_get(&ls, 0)->class == log_class_error);
+    CHECK(log_store_get(&ls, 0)->flags == 3);
+    free(line);
+    log_store_free(&ls);
+}
+
+static void
+test_parse(void)
+{
+    time_t timestamp;
+    log_class_t class;
+    const char *message;
+
+    CHECK(log_parse_mgmt_line("1700000000,W,hello, world", &timestamp, &class, &message));
+    CHECK(timestamp == 1700000000);
+    CHECK(class == log_class_warning);
+    CHECK(strcmp(message, "hello, world") == 0);
+
+    CHECK(log_parse_mgmt_line("1,IN,x", &timestamp, &class, &message));
+    CHECK(class == log_class_error);
+    CHECK(log_parse_mgmt_line("1,,x", &timestamp, &class, &message));
+    CHECK(class == log_class_normal);
+    CHECK(!log_parse_mgmt_line("1,W", &timestamp, &class, &message));
+
+    CHECK(log_classify_prefix(L"GUI> ERROR: ") == log_class_error);
+    CHECK(log_classify_prefix(L"GUI> WARNING: ") == log_class_warning);
+    CHECK(log_classify_prefix(L"GUI> ") == log_class_normal);
+}
+
+static void
+test_writer(void)
+{
+    log_writer_t lw = { 0 };
+    int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        CHECK(log_writer_append(&lw, L"date ", NULL, L"message"));
+    }
+    CHECK(lw.len == 1000 * 13);
+    CHECK(wcslen(lw.text) == lw.len);
+    CHECK(wcsncmp(lw.text, L"date message\ndate", 17) == 0);
+    log_writer_clear(&lw);
+    CHECK(lw.len == 0 && lw.text[0] == L'\0');
+    log_writer_free(&lw);
+}
+
+int
+main(void)
+{
+    test_line_eviction();
+    test_text_wrap_around();
+    test_crlf_collapse();
+    test_limits();
+    test_parse();
+    test_writer();
+    return test_failures != 0;
+}
@@ -0,0 +1,187 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* included to reach hash_name() for building colliding names */
+#include "name_index.c"
+#include "test.h"
+
+#define NAMES 5000
+
+static void
+test_case_insensitive(void)
+{
+    name_index_t ni = { 0 };
+    int a, b;
+
+    CHECK(name_index_find(&ni, L"home") == NULL);
+    CHECK(name_index_add(&ni, L"Home", &a));
+    CHECK(name_index_add(&ni, L"office.ovpn", &b));
+
+    CHECK(name_index_find(&ni, L"Home") == &a);
+    CHECK(name_index_find(&ni, L"HOME") == &a);
+    CHECK(name_index_find(&ni, L"hOmE") == &a);
+    CHECK(name_index_find(&ni, L"Office.OVPN") == &b);
+    CHECK(name_index_find(&ni, L"Hom") == NULL);
+    CHECK(name_index_find(&ni, L"Homes") == NULL);
+    CHECK(name_index_find(&ni, L"") == NULL);
+    name_index_clear(&ni);
+    CHECK(ni.count == 0 && ni.slots == NULL);
+}
+
+/* names probing through the same slots are kept apart */
+static void
+test_collisions(void)
+{
+    name_index_t ni = { 0 };
+    wchar_t names[8][16];
+    unsigned int slot = hash_name(L"n0") & (NAME_INDEX_MIN_SIZE - 1);
+    int found = 0;
+    int i;
+
+    /* names landing in the same slot of the initial table */
+    for (i = 0; found < 8; i++)
+    {
+        swprintf(names[found], 16, L"n%d", i);
+        if ((hash_name(names[found]) & (NAME_INDEX_MIN_SIZE - 1)) == slot)
+        {
+            found++;
+        }
+    }
+    for (i = 0; i < 8; i++)
+    {
+        CHECK(name_index_add(&ni, names[i], names[i]));
+    }
+    CHECK(ni.size == NAME_INDEX_MIN_SIZE);
+    CHECK(ni.count == 8);
+    for (i = 0; i < 8; i++)
+    {
+        CHECK(name_index_find(&ni, names[i]) == names[i]);
+    }
+    name_index_clear(&ni);
+}
+
+/* the table grows keeping the load factor at or below 1/2 */
+static void
+test_growth(void)
+{
+    static wchar_t names[NAMES][16];
+    name_index_t ni = { 0 };
+    int i;
+
+    for (i = 0; i < NAMES; i++)
+    {
+        swprintf(names[i], 16, L"Config-%d", i);
+        CHECK(name_index_add(&ni, names[i], names[i]));
+        CHECK(2 * ni.count <= ni.size);
+    }
+    CHECK(ni.count == NAMES);
+    CHECK((ni.size & (ni.size - 1)) == 0);
+
+    for (i = 0; i < NAMES; i++)
+    {
+        wchar_t upper[16];
+        swprintf(upper, 16, L"CONFIG-%d", i);
+        CHECK(name_index_find(&ni, upper) == names[i]);
+    }
+    CHECK(name_index_find(&ni, L"config-5000") == NULL);
+    name_index_clear(&ni);
+}
+
+typedef struct {
+    int id;
+    const wchar_t *file;
+    const wchar_t *name;
+} conn_t;
+
+/* as GetConnByName(): the connection with the lowest id matching either way */
+static conn_t *
+get_conn_by_name(name_index_t *by_file, name_index_t *by_name, const wchar_t *name)
+{
+    conn_t *f = name_index_find(by_file, name);
+    conn_t *n = name_index_find(by_name, name);
+
+    if (f && n)
+    {
+        return f->id < n->id ? f : n;
+    }
+    return f ? f : n;
+}
+
+/* connections added in id order: the first added keeps a duplicate name */
+static void
+test_lowest_id_wins(void)
+{
+    conn_t conn[] = {
+        { 0, L"work.ovpn", L"work" },
+        { 1, L"Work.ovpn", L"Work" },         /* in another config dir */
+        { 2, L"home.ovpn", L"home" },
+        { 3, L"work", L"work (2)" },          /* file named like conn[0] */
+        { 4, L"x.ovpn", L"home.ovpn" },       /* name like the file of conn[2] */
+    };
+    name_index_t by_file = { 0 }, by_name = { 0 };
+    size_t i;
+
+    for (i = 0; i < sizeof(conn)/sizeof(conn[0]); i++)
+    {
+        CHECK(name_index_add(&by_file, conn[i].file, &conn[i]));
+        CHECK(name_index_add(&by_name, conn[i].name, &conn[i]));
+    }
+
+    CHECK(name_index_find(&by_name, L"WORK") == &conn[0]);
+    CHECK(name_index_find(&by_file, L"work.OVPN") == &conn[0]);
+    CHECK(get_conn_by_name(&by_file, &by_name, L"work") == &conn[0]);
+    CHECK(get_conn_by_name(&by_file, &by_name, L"home.ovpn") == &conn[2]);
+    CHECK(get_conn_by_name(&by_file, &by_name, L"x.ovpn") == &conn[4]);
+    CHECK(get_conn_by_name(&by_file, &by_name, L"work (2)") == &conn[3]);
+    CHECK(get_conn_by_name(&by_file, &by_name, L"none") == NULL);
+
+    name_index_clear(&by_file);
+    name_index_clear(&by_name);
+}
+
+static void
+test_intern(void)
+{
+    name_index_t ni = { 0 };
+    wchar_t buf[32] = L"C:\\Users\\me\\OpenVPN\\config";
+
+    const wchar_t *a = name_index_intern(&ni, buf);
+    CHECK(a && a != buf && wcscmp(a, buf) == 0);
+
+    buf[0] = L'c';
+    CHECK(name_index_intern(&ni, buf) == a);
+    CHECK(wcscmp(a, L"C:\\Users\\me\\OpenVPN\\config") == 0);   /* first spelling kept */
+
+    const wchar_t *b = name_index_intern(&ni, L"D:\\config");
+    CHECK(b && b != a);
+    CHECK(ni.count == 2);
+    name_index_free_interned(&ni);
+    CHECK(ni.count == 0);
+}
+
+int
+main(void)
+{
+    test_case_insensitive();
+    test_collisions();
+    test_growth();
+    test_lowest_id_wins();
+    test_intern();
+    return test_failures != 0;
+}
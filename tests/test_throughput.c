@@ -0,0 +1,174 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <math.h>
+#include <string.h>
+#include "throughput.h"
+#include "test.h"
+
+static int
+near(double value, double expect)
+{
+    return fabs(value - expect) <= 1e-9 * fabs(expect) + 1e-9;
+}
+
+/* the oldest samples are dropped once THROUGHPUT_SAMPLES are kept */
+static void
+test_sample_ring(void)
+{
+    throughput_t tp;
+    size_t i;
+
+    throughput_reset(&tp);
+    CHECK(throughput_sample(&tp, 0) == NULL);
+    for (i = 0; i < 100; i++)
+    {
+        throughput_add(&tp, 5 * i, 1000 * i, 10 * i);
+    }
+
+    CHECK(tp.sample_count == THROUGHPUT_SAMPLES);
+    CHECK(throughput_sample(&tp, THROUGHPUT_SAMPLES) == NULL);
+    for (i = 0; i < THROUGHPUT_SAMPLES; i++)
+    {
+        const throughput_sample_t *s = throughput_sample(&tp, i);
+        size_t n = 100 - THROUGHPUT_SAMPLES + i;
+        CHECK(s && s->time == (time_t) (5 * n) && s->bytes_in == 1000 * n && s->bytes_out == 10 * n);
+    }
+}
+
+/* per minute and per hour totals, the minute ring wrapping around */
+static void
+test_series(void)
+{
+    throughput_t tp;
+    size_t i;
+
+    throughput_reset(&tp);
+    for (i = 0; i <= 100; i++)
+    {
+        throughput_add(&tp, 60 * i + 30, 6000 * i, 60 * i);
+    }
+
+    CHECK(tp.minutes.count == THROUGHPUT_MINUTES);
+    CHECK(throughput_bucket(&tp.minutes, THROUGHPUT_MINUTES) == NULL);
+    for (i = 0; i < THROUGHPUT_MINUTES; i++)
+    {
+        const throughput_bucket_t *b = throughput_bucket(&tp.minutes, i);
+        CHECK(b && b->start == (time_t) (60 * (41 + i)) && b->bytes_in == 6000 && b->bytes_out == 60);
+    }
+
+    /* minutes 1-59 in the first hour, 60-100 in the second */
+    CHECK(tp.hours.count == 2);
+    CHECK(throughput_bucket(&tp.hours, 0)->start == 0);
+    CHECK(throughput_bucket(&tp.hours, 0)->bytes_in == 59 * 6000);
+    CHECK(throughput_bucket(&tp.hours, 1)->start == 3600);
+    CHECK(throughput_bucket(&tp.hours, 1)->bytes_in == 41 * 6000);
+    CHECK(throughput_bucket(&tp.hours, 1)->bytes_out == 41 * 60);
+
+    /* a clock going back adds to the latest bucket */
+    throughput_add(&tp, 0, 6000 * 101, 60 * 101);
+    CHECK(tp.minutes.count == THROUGHPUT_MINUTES);
+    CHECK(throughput_bucket(&tp.minutes, THROUGHPUT_MINUTES - 1)->bytes_in == 12000);
+}
+
+/* the rate approaches a constant rate and decays with time constant tau */
+static void
+test_rate(void)
+{
+    throughput_t tp;
+    unsigned long long bytes = 0;
+    int t;
+
+    throughput_reset(&tp);
+    throughput_add(&tp, 0, 0, 0);
+    for (t = 1; t <= 20; t++)
+    {
+        bytes += 1000;
+        throughput_add(&tp, t, bytes, bytes / 2);
+    }
+    /* independent of the sampling interval: R (1 - exp(-t/tau)) */
+    double rate = 1000 * (1 - exp(-20 / THROUGHPUT_RATE_TAU));
+    CHECK(near(tp.rate_in, rate));
+    CHECK(near(tp.rate_out, rate / 2));
+
+    /* no traffic for tau seconds in one sample: down by a factor e */
+    throughput_add(&tp, 40, bytes, bytes / 2);
+    CHECK(near(tp.rate_in, rate * exp(-1)));
+
+    /* the same in 5 s steps */
+    for (t = 45; t <= 60; t += 5)
+    {
+        throughput_add(&tp, t, bytes, bytes / 2);
+    }
+    CHECK(near(tp.rate_in, rate * exp(-2)));
+
+    /* samples without elapsed time leave the rate alone */
+    throughput_add(&tp, 60, bytes + 500, bytes / 2);
+    CHECK(near(tp.rate_in, rate * exp(-2)));
+
+    /* counters going down start over */
+    throughput_add(&tp, 61, 10, 10);
+    CHECK(tp.rate_in == 0 && tp.rate_out == 0);
+    throughput_add(&tp, 81, 20010, 10);
+    CHECK(near(tp.rate_in, 1000 * (1 - exp(-1))));
+    CHECK(tp.rate_out == 0);
+}
+
+static void
+test_csv(void)
+{
+    static const char expect[] =
+        "series,time,bytes_in,bytes_out\n"
+        "sample,3590,100,10\n"
+        "sample,3610,300,40\n"
+        "sample,3670,350,45\n"
+        "minute,3600,200,30\n"
+        "minute,3660,50,5\n"
+        "hour,3600,250,35\n";
+    throughput_t tp;
+    char buf[512];
+    FILE *fp = tmpfile();
+
+    CHECK(fp != NULL);
+    if (!fp)
+    {
+        return;
+    }
+    throughput_reset(&tp);
+    throughput_add(&tp, 3590, 100, 10);
+    throughput_add(&tp, 3610, 300, 40);
+    throughput_add(&tp, 3670, 350, 45);
+
+    CHECK(throughput_write_csv(&tp, fp));
+    rewind(fp);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    buf[len] = '\0';
+    CHECK(strcmp(buf, expect) == 0);
+    fclose(fp);
+}
+
+int
+main(void)
+{
+    test_sample_ring();
+    test_series();
+    test_rate();
+    test_csv();
+    return test_failures != 0;
+}
@@ -0,0 +1,171 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "throughput.h"
+
+void
+throughput_reset(throughput_t *tp)
+{
+    memset(tp, 0, sizeof(*tp));
+    tp->minutes.bucket = tp->minute_buf;
+    tp->minutes.size = THROUGHPUT_MINUTES;
+    tp->minutes.period = 60;
+    tp->hours.bucket = tp->hour_buf;
+    tp->hours.size = THROUGHPUT_HOURS;
+    tp->hours.period = 3600;
+}
+
+const throughput_sample_t *
+throughput_sample(const throughput_t *tp, size_t i)
+{
+    if (i >= tp->sample_count)
+    {
+        return NULL;
+    }
+    return &tp->sample[(tp->sample_head + i) % THROUGHPUT_SAMPLES];
+}
+
+const throughput_bucket_t *
+throughput_bucket(const throughput_series_t *ts, size_t i)
+{
+    if (i >= ts->count)
+    {
+        return NULL;
+    }
+    return &ts->bucket[(ts->head + i) % ts->size];
+}
+
+/* add bytes transferred at time t to its bucket, starting a new one as needed */
+static void
+series_add(throughput_series_t *ts, time_t t, unsigned long long in, unsigned long long out)
+{
+    time_t start = t - t % ts->period;
+    throughput_bucket_t *b = NULL;
+
+    if (ts->count > 0)
+    {
+        b = &ts->bucket[(ts->head + ts->count - 1) % ts->size];
+        if (start < b->start)
+        {
+            start = b->start; /* clock went back: keep adding to the latest */
+        }
+    }
+
+    if (!b || b->start != start)
+    {
+        if (ts->count == ts->size)
+        {
+            ts->head = (ts->head + 1) % ts->size;
+            ts->count--;
+        }
+        b = &ts->bucket[(ts->head + ts->count++) % ts->size];
+        b->start = start;
+        b->bytes_in = b->bytes_out = 0;
+    }
+
+    b->bytes_in += in;
+    b->bytes_out += out;
+}
+
+void
+throughput_add(throughput_t *tp, time_t t, unsigned long long bytes_in,
+               unsigned long long bytes_out)
+{
+    const throughput_sample_t *last = NULL;
+
+    if (tp->sample_count > 0)
+    {
+        last = throughput_sample(tp, tp->sample_count - 1);
+    }
+
+    if (last && bytes_in >= last->bytes_in && bytes_out >= last->bytes_out)
+    {
+        unsigned long long in = bytes_in - last->bytes_in;
+        unsigned long long out = bytes_out - last->bytes_out;
+        double dt = difftime(t, last->time);
+
+        series_add(&tp->minutes, t, in, out);
+        series_add(&tp->hours, t, in, out);
+
+        if (dt > 0)
+        {
+            /* weight of the new rate grows with the time it covers */
+            double alpha = 1.0 - exp(-dt / THROUGHPUT_RATE_TAU);
+            tp->rate_in += alpha * (in / dt - tp->rate_in);
+            tp->rate_out += alpha * (out / dt - tp->rate_out);
+        }
+    }
+    else if (last)
+    {
+        tp->rate_in = tp->rate_out = 0;
+    }
+
+    if (tp->sample_count == THROUGHPUT_SAMPLES)
+    {
+        tp->sample_head = (tp->sample_head + 1) % THROUGHPUT_SAMPLES;
+        tp->sample_count--;
+    }
+    throughput_sample_t *s = &tp->sample[(tp->sample_head + tp->sample_count++) % THROUGHPUT_SAMPLES];
+    s->time = t;
+    s->bytes_in = bytes_in;
+    s->bytes_out = bytes_out;
+}
+
+static int
+write_series(const throughput_series_t *ts, const char *name, FILE *fp)
+{
+    for (size_t i = 0; i < ts->count; i++)
+    {
+        const throughput_bucket_t *b = throughput_bucket(ts, i);
+        if (fprintf(fp, "%s,%lld,%llu,%llu\n", name, (long long) b->start,
+                    b->bytes_in, b->bytes_out) < 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+throughput_write_csv(const throughput_t *tp, FILE *fp)
+{
+    if (fprintf(fp, "series,time,bytes_in,bytes_out\n") < 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < tp->sample_count; i++)
+    {
+        const throughput_sample_t *s = throughput_sample(tp, i);
+        if (fprintf(fp, "sample,%lld,%llu,%llu\n", (long long) s->time,
+                    s->bytes_in, s->bytes_out) < 0)
+        {
+            return 0;
+        }
+    }
+
+    return write_series(&tp->minutes, "minute", fp)
+           && write_series(&tp->hours, "hour", fp);
+}
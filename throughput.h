@@ -0,0 +1,98 @@
+/*
+ *  OpenVPN-GUI -- A Windows GUI for OpenVPN.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program (see the file COPYING included with this
+ *  distribution); if not, write to the Free Software Foundation, Inc.,
+ *  59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Fixed size history of the traffic of a connection fed with the
+ * cumulative byte counts reported by the daemon: the latest samples,
+ * bytes transferred per minute and per hour, and a smoothed current
+ * rate. This module has no Windows dependency. A throughput_t refers
+ * to its own buffers: initialize it in place and do not copy it.
+ */
+
+#define THROUGHPUT_SAMPLES 64       /* raw samples kept */
+#define THROUGHPUT_MINUTES 60       /* per minute totals kept */
+#define THROUGHPUT_HOURS 24         /* per hour totals kept */
+#define THROUGHPUT_RATE_TAU 20.0    /* time constant of the rate average in seconds */
+
+typedef struct {
+    time_t time;
+    unsigned long long bytes_in;    /* cumulative counts as reported */
+    unsigned long long bytes_out;
+} throughput_sample_t;
+
+/* bytes transferred in the period starting at start */
+typedef struct {
+    time_t start;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+} throughput_bucket_t;
+
+/* ring of buckets of a given period, newest last */
+typedef struct {
+    throughput_bucket_t *bucket;
+    size_t size;
+    size_t head;                    /* index of the oldest bucket */
+    size_t count;
+    int period;                     /* seconds */
+} throughput_series_t;
+
+typedef struct {
+    throughput_sample_t sample[THROUGHPUT_SAMPLES];
+    size_t sample_head;             /* index of the oldest sample */
+    size_t sample_count;
+    throughput_bucket_t minute_buf[THROUGHPUT_MINUTES];
+    throughput_bucket_t hour_buf[THROUGHPUT_HOURS];
+    throughput_series_t minutes;
+    throughput_series_t hours;
+    double rate_in;                 /* bytes per second, exponentially weighted */
+    double rate_out;
+} throughput_t;
+
+/* empty the history */
+void throughput_reset(throughput_t *tp);
+
+/*
+ * Add a sample of the cumulative counts at time t. Counts going down
+ * mean the counters were reset: the sample starts a new baseline.
+ */
+void throughput_add(throughput_t *tp, time_t t, unsigned long long bytes_in,
+                    unsigned long long bytes_out);
+
+/* the i-th sample counting from the oldest or NULL if out of range */
+const throughput_sample_t *throughput_sample(const throughput_t *tp, size_t i);
+
+/* the i-th bucket counting from the oldest or NULL if out of range */
+const throughput_bucket_t *throughput_bucket(const throughput_series_t *ts, size_t i);
+
+/*
+ * Write the history as CSV lines "series,time,bytes_in,bytes_out" where
+ * series is "sample" with cumulative counts, or "minute" and "hour" with
+ * the bytes transferred in the period starting at time. Returns 0 on
+ * write error.
+ */
+int throughput_write_csv(const throughput_t *tp, FILE *fp);
+
+#endif /* ifndef THROUGHPUT_H */
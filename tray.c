@@ -28,6 +28,7 @@
 #include <shellapi.h>
 #include <tchar.h>
 #include <time.h>
+#include <stdlib.h>
 #include <commctrl.h>
 
 #include "tray.h"
@@ -50,6 +51,18 @@ HMENU *hMenuConn;
 HMENU hMenuImport;
 int hmenu_size = 0; /* allocated size of hMenuConn array */
 
+/* settings the popup menus were last built with */
+static struct {
+    DWORD config_menu_view;
+    DWORD enable_persistent;
+    service_state_t service_state;
+    BOOL nested;
+    int num_configs;
+} menu_built_with;
+
+/* incremented each time the menus are created, see GroupMenuBuilt() */
+static unsigned int menu_generation;
+
 HBITMAP hbmpConnecting;
 
 NOTIFYICONDATA ni;
@@ -159,6 +172,8 @@ AllocateConnectionMenu()
     HMENU *tmp  = (HMENU *) realloc(hMenuConn, sizeof(HMENU)*(o.num_configs + 50));
     if (tmp)
     {
+        /* menus of new entries are created when first displayed */
+        memset(tmp + hmenu_size, 0, sizeof(HMENU)*(o.num_configs + 50 - hmenu_size));
         hmenu_size = o.num_configs + 50;
         hMenuConn = tmp;
     }
@@ -170,44 +185,179 @@ AllocateConnectionMenu()
     return;
 }
 
-/* Create popup menus */
-void
-CreatePopupMenus()
+/* The group whose menu lists connection c, NULL on error */
+static config_group_t *
+MenuParent(connection_t *c)
 {
-    /* We use groups[0].menu as the root menu, so,
-     * even if num_configs = 0, we want num_groups > 0.
-     * This is guaranteed as the root node is always defined.
-     */
-    if (o.num_groups <= 0)
+    if (USE_NESTED_CONFIG_MENU)
     {
-        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"%hs:%d Logic error - no config groups", __func__, __LINE__);
-        return;
+        return CONFIG_GROUP(c);
+    }
+    else if (c->flags & FLAG_DAEMON_PERSISTENT)
+    {
+        /* Persistent connections always displayed under a submenu */
+        return PERSISTENT_ROOT_GROUP;
     }
+    return &o.groups[0]; /* by default config is added to the root */
+}
 
-    AllocateConnectionMenu();
+/* True if the items of the group menu are in place and current */
+static BOOL
+GroupMenuBuilt(const config_group_t *cg)
+{
+    return cg->menu && cg->menu_gen == menu_generation;
+}
 
-    CreateMenuBitmaps();
-    MENUINFO minfo = {.cbSize = sizeof(MENUINFO)};
+/* Remove all items from a menu without destroying its submenus */
+static void
+ClearMenu(HMENU menu)
+{
+    while (RemoveMenu(menu, 0, MF_BYPOSITION))
+    {
+    }
+}
 
-    for (connection_t *c = o.chead; c; c = c->next)
+/* The popup menu of a connection, created empty if not yet there */
+static HMENU
+ConnectionMenu(connection_t *c)
+{
+    if (!hMenuConn[c->id])
     {
+        MENUINFO minfo = {.cbSize = sizeof(MENUINFO)};
+
         hMenuConn[c->id] = CreatePopupMenu();
         /* Save the connection index in the menu.*/
         minfo.fMask = MIM_MENUDATA;
         minfo.dwMenuData = (ULONG_PTR) c;
         SetMenuInfo(hMenuConn[c->id], &minfo);
     }
-    for (int i = 0; i < o.num_groups; i++)
+    return hMenuConn[c->id];
+}
+
+/* Add the actions to the popup menu of a connection */
+static void
+FillConnectionMenu(HMENU menu)
+{
+    AppendMenu(menu, MF_STRING, IDM_CONNECTMENU, LoadLocalizedString(IDS_MENU_CONNECT));
+    AppendMenu(menu, MF_STRING, IDM_DISCONNECTMENU, LoadLocalizedString(IDS_MENU_DISCONNECT));
+    AppendMenu(menu, MF_STRING, IDM_RECONNECTMENU, LoadLocalizedString(IDS_MENU_RECONNECT));
+    AppendMenu(menu, MF_STRING, IDM_STATUSMENU, LoadLocalizedString(IDS_MENU_STATUS));
+    AppendMenu(menu, MF_SEPARATOR, 0, 0);
+
+    AppendMenu(menu, MF_STRING, IDM_VIEWLOGMENU, LoadLocalizedString(IDS_MENU_VIEWLOG));
+
+    AppendMenu(menu, MF_STRING, IDM_EDITMENU, LoadLocalizedString(IDS_MENU_EDITCONFIG));
+    AppendMenu(menu, MF_STRING, IDM_CLEARPASSMENU, LoadLocalizedString(IDS_MENU_CLEARPASS));
+}
+
+/* Add import, settings and close items to the root menu */
+static void
+AppendGlobalItems(void)
+{
+    AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, LoadLocalizedString(IDS_MENU_IMPORT));
+    AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, LoadLocalizedString(IDS_MENU_SETTINGS));
+    AppendMenu(hMenu, MF_STRING, IDM_CLOSE, LoadLocalizedString(IDS_MENU_CLOSE));
+}
+
+/*
+ * (Re)build the items of a group menu: its sub-groups and connections.
+ * Menus of sub-groups and connections are only created here, and
+ * filled in when they are about to be displayed.
+ */
+static void
+BuildGroupMenu(config_group_t *cg)
+{
+    int pos = 0;
+
+    ClearMenu(cg->menu);
+
+    /* i = 0 is the root menu and has no parent */
+    for (int i = 1; i < o.num_groups; i++)
     {
-        if (!o.groups[i].active)
+        config_group_t *this = &o.groups[i];
+
+        /* Root group of persistent connections is always displayed if active.
+         * Add the rest only if (USE_NESTED_CONFIG_MENU)
+         */
+        if (this->parent != cg->id || !this->active
+            || (this != PERSISTENT_ROOT_GROUP && !USE_NESTED_CONFIG_MENU))
         {
             continue;
         }
-        o.groups[i].menu = CreatePopupMenu();
-        o.groups[i].children = 0; /* we have to recount this when assigning menu position index */
+        if (!this->menu)
+        {
+            this->menu = CreatePopupMenu();
+        }
+        AppendMenu(cg->menu, MF_POPUP, (UINT_PTR) this->menu, this->name);
+        this->pos = pos++;
     }
 
-    hMenu = o.groups[0].menu; /* the first group menu is also the root menu */
+    /* add config file (connection) entries */
+    for (connection_t *c = o.chead; c; c = c->next)
+    {
+        if (MenuParent(c) != cg)
+        {
+            continue;
+        }
+        AppendMenu(cg->menu, MF_POPUP, (UINT_PTR) ConnectionMenu(c), c->config_name);
+        c->pos = pos++;
+    }
+
+    if (cg == &o.groups[0])
+    {
+        if (o.num_configs > 0)
+        {
+            AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
+        }
+        AppendGlobalItems();
+    }
+
+    cg->menu_gen = menu_generation;
+
+    PrintDebug(L"Menu of group %ls built with %d entries", cg->name, pos);
+
+    /* restore check marks of active connections and the groups leading to them */
+    AcquireSRWLockShared(&o.state_lock);
+    for (int i = 0; i < CONN_STATE_COUNT; i++)
+    {
+        if (i == disconnected || i == detached || i == onhold)
+        {
+            continue;
+        }
+        for (connection_t *c = o.conn_in_state[i]; c; c = c->state_next)
+        {
+            SetMenuStatus(c, c->state);
+        }
+    }
+    ReleaseSRWLockShared(&o.state_lock);
+}
+
+/*
+ * Create popup menus. Only the root menu is created here: submenus are
+ * built by OnInitMenuPopup() when they are about to be opened.
+ */
+void
+CreatePopupMenus()
+{
+    /* We use groups[0].menu as the root menu, so,
+     * even if num_configs = 0, we want num_groups > 0.
+     * This is guaranteed as the root node is always defined.
+     */
+    if (o.num_groups <= 0)
+    {
+        MsgToEventLog(EVENTLOG_ERROR_TYPE, L"%hs:%d Logic error - no config groups", __func__, __LINE__);
+        return;
+    }
+
+    AllocateConnectionMenu();
+
+    CreateMenuBitmaps();
+    MENUINFO minfo = {.cbSize = sizeof(MENUINFO)};
+
+    /* menus built before this are out of date */
+    menu_generation++;
+
+    hMenu = o.groups[0].menu = CreatePopupMenu(); /* the first group menu is also the root menu */
 
     /* Set notify by position style for the top menu - gets automatically applied to sub-menus */
     minfo.fMask = MIM_STYLE;
@@ -215,6 +365,11 @@ CreatePopupMenus()
     minfo.dwStyle |= MNS_NOTIFYBYPOS;
     SetMenuInfo(hMenu, &minfo);
 
+    hMenuImport = CreatePopupMenu();
+    AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, LoadLocalizedString(IDS_MENU_IMPORT_FILE));
+    AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, LoadLocalizedString(IDS_MENU_IMPORT_AS));
+    AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, LoadLocalizedString(IDS_MENU_IMPORT_URL));
+
     if (o.num_configs == 1 && o.chead)
     {
         /* Set main menu's menudata to first connection */
@@ -224,140 +379,155 @@ CreatePopupMenus()
         SetMenuInfo(hMenu, &minfo);
 
         /* Create Main menu with actions */
-        AppendMenu(hMenu, MF_STRING, IDM_CONNECTMENU, LoadLocalizedString(IDS_MENU_CONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_DISCONNECTMENU, LoadLocalizedString(IDS_MENU_DISCONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_RECONNECTMENU, LoadLocalizedString(IDS_MENU_RECONNECT));
-        AppendMenu(hMenu, MF_STRING, IDM_STATUSMENU, LoadLocalizedString(IDS_MENU_STATUS));
+        FillConnectionMenu(hMenu);
         AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
+        AppendGlobalItems();
 
-        AppendMenu(hMenu, MF_STRING, IDM_VIEWLOGMENU, LoadLocalizedString(IDS_MENU_VIEWLOG));
-
-        AppendMenu(hMenu, MF_STRING, IDM_EDITMENU, LoadLocalizedString(IDS_MENU_EDITCONFIG));
-        AppendMenu(hMenu, MF_STRING, IDM_CLEARPASSMENU, LoadLocalizedString(IDS_MENU_CLEARPASS));
+        o.groups[0].menu_gen = menu_generation;
 
-        AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
+        SetMenuStatus(o.chead,  o.chead->state);
+    }
 
-        hMenuImport = CreatePopupMenu();
-        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, LoadLocalizedString(IDS_MENU_IMPORT));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, LoadLocalizedString(IDS_MENU_IMPORT_FILE));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, LoadLocalizedString(IDS_MENU_IMPORT_AS));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, LoadLocalizedString(IDS_MENU_IMPORT_URL));
+    menu_built_with.config_menu_view = o.config_menu_view;
+    menu_built_with.enable_persistent = o.enable_persistent;
+    menu_built_with.service_state = o.service_state;
+    menu_built_with.nested = USE_NESTED_CONFIG_MENU;
+    menu_built_with.num_configs = o.num_configs;
+}
 
-        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, LoadLocalizedString(IDS_MENU_SETTINGS));
-        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, LoadLocalizedString(IDS_MENU_CLOSE));
+/*
+ * Build a menu about to be displayed if it is new or out of date.
+ * Called on WM_INITMENUPOPUP.
+ */
+void
+OnInitMenuPopup(HMENU menu)
+{
+    MENUINFO minfo = {.cbSize = sizeof(MENUINFO), .fMask = MIM_MENUDATA};
+    connection_t *c;
 
-        SetMenuStatus(o.chead,  o.chead->state);
-    }
-    else
+    GetMenuInfo(menu, &minfo);
+    c = (connection_t *) minfo.dwMenuData;
+    if (c && c->id < hmenu_size && hMenuConn[c->id] == menu)
     {
-        /* construct the submenu tree first */
-        /* i = 0 is the root menu and has no parent */
-        for (int i = 1; i < o.num_groups; i++)
+        if (GetMenuItemCount(menu) == 0)
         {
-            config_group_t *this = &o.groups[i];
-            config_group_t *parent = PARENT_GROUP(this);
-
-            /* Root group of persistent connections is always displayed if active.
-             * Add the rest only if (USE_NESTED_CONFIG_MENU)
-             */
-            if (!this->active || !parent
-                || (this != PERSISTENT_ROOT_GROUP && !USE_NESTED_CONFIG_MENU))
-            {
-                continue;
-            }
-            AppendMenu(parent->menu, MF_POPUP, (UINT_PTR) this->menu, this->name);
-            this->pos = parent->children++;
-
-            PrintDebug(L"Submenu %d named %ls added to parent %ls with position %d",
-                       i, this->name, parent->name, this->pos);
+            FillConnectionMenu(menu);
         }
+        SetMenuStatus(c, c->state);
+        return;
+    }
 
-        /* add config file (connection) entries */
-        for (connection_t *c = o.chead; c; c = c->next)
+    for (int i = 0; i < o.num_groups; i++)
+    {
+        if (o.groups[i].menu == menu)
         {
-            config_group_t *parent = &o.groups[0]; /* by default config is added to the root */
-
-            if (USE_NESTED_CONFIG_MENU)
-            {
-                parent = CONFIG_GROUP(c);
-            }
-            else if (c->flags & FLAG_DAEMON_PERSISTENT)
+            if (!GroupMenuBuilt(&o.groups[i]))
             {
-                /* Persistent connections always displayed under a submenu */
-                parent = PERSISTENT_ROOT_GROUP;
+                BuildGroupMenu(&o.groups[i]);
             }
-            if (!parent)
-            {
-                MsgToEventLog(EVENTLOG_ERROR_TYPE, L"%hs:%d Logic error - parent = NULL", __func__, __LINE__);
-                continue; /* ignore this config */
-            }
-
-            /* Add config to the current sub menu */
-            AppendMenu(parent->menu, MF_POPUP, (UINT_PTR) hMenuConn[c->id], c->config_name);
-            c->pos = parent->children++;
-
-            PrintDebug(L"Config %d named %ls added to submenu %ls with position %d",
-                       c->id, c->config_name, parent->name, c->pos);
-        }
-
-        if (o.num_configs > 0)
-        {
-            AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
-        }
-
-        hMenuImport = CreatePopupMenu();
-        AppendMenu(hMenu, MF_POPUP, (UINT_PTR) hMenuImport, LoadLocalizedString(IDS_MENU_IMPORT));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_FILE, LoadLocalizedString(IDS_MENU_IMPORT_FILE));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_AS, LoadLocalizedString(IDS_MENU_IMPORT_AS));
-        AppendMenu(hMenuImport, MF_STRING, IDM_IMPORT_URL, LoadLocalizedString(IDS_MENU_IMPORT_URL));
-
-        AppendMenu(hMenu, MF_STRING, IDM_SETTINGS, LoadLocalizedString(IDS_MENU_SETTINGS));
-        AppendMenu(hMenu, MF_STRING, IDM_CLOSE, LoadLocalizedString(IDS_MENU_CLOSE));
-
-        /* Create popup menus for every connection */
-        for (connection_t *c = o.chead; c; c = c->next)
-        {
-            int i = c->id;
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_CONNECTMENU, LoadLocalizedString(IDS_MENU_CONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_DISCONNECTMENU, LoadLocalizedString(IDS_MENU_DISCONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_RECONNECTMENU, LoadLocalizedString(IDS_MENU_RECONNECT));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_STATUSMENU, LoadLocalizedString(IDS_MENU_STATUS));
-            AppendMenu(hMenuConn[i], MF_SEPARATOR, 0, 0);
-
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_VIEWLOGMENU, LoadLocalizedString(IDS_MENU_VIEWLOG));
-
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_EDITMENU, LoadLocalizedString(IDS_MENU_EDITCONFIG));
-            AppendMenu(hMenuConn[i], MF_STRING, IDM_CLEARPASSMENU, LoadLocalizedString(IDS_MENU_CLEARPASS));
-
-            SetMenuStatus(c, c->state);
+            return;
         }
     }
 }
 
-
 /* Destroy popup menus */
 static void
 DestroyPopupMenus()
 {
-    for (connection_t *c = o.chead; c; c = c->next)
+    /* detach all submenus first so that each is destroyed exactly once */
+    for (int i = 0; i < o.num_groups; i++)
     {
-        DestroyMenu(hMenuConn[c->id]);
+        if (o.groups[i].menu)
+        {
+            ClearMenu(o.groups[i].menu);
+        }
+    }
+    for (int i = 0; i < o.num_groups; i++)
+    {
+        if (o.groups[i].menu)
+        {
+            DestroyMenu(o.groups[i].menu);
+            o.groups[i].menu = NULL;
+        }
+    }
+    for (connection_t *c = o.chead; c && hMenuConn; c = c->next)
+    {
+        if (c->id < hmenu_size && hMenuConn[c->id])
+        {
+            DestroyMenu(hMenuConn[c->id]);
+            hMenuConn[c->id] = NULL;
+        }
     }
 
     DestroyMenu(hMenuImport);
-    DestroyMenu(hMenu);
 
     hMenuImport = NULL;
     hMenu = NULL;
 }
 
-/* Rescan config folders and recreate popup menus */
+/* True if the menus have to be created again to change their layout */
+static BOOL
+MenuLayoutChanged(void)
+{
+    return menu_built_with.config_menu_view != o.config_menu_view
+           || menu_built_with.enable_persistent != o.enable_persistent
+           || menu_built_with.service_state != o.service_state
+           || menu_built_with.nested != USE_NESTED_CONFIG_MENU
+           || (menu_built_with.num_configs == 1) != (o.num_configs == 1);
+}
+
+/*
+ * Rescan config folders and update popup menus. As configs are only
+ * ever added, only the menus of groups leading to new configs are
+ * marked out of date unless the layout of the whole tree changes.
+ */
 void
 RecreatePopupMenus(void)
 {
-    DestroyPopupMenus();
+    int num_configs = o.num_configs;
+
+    if (num_configs == 0)
+    {
+        DestroyPopupMenus(); /* the group tree is rebuilt from scratch */
+    }
+
     BuildFileList();
-    CreatePopupMenus();
+
+    if (!hMenu || MenuLayoutChanged())
+    {
+        DestroyPopupMenus();
+        CreatePopupMenus();
+        return;
+    }
+
+    AllocateConnectionMenu();
+    for (connection_t *c = o.chead; c; c = c->next)
+    {
+        if (c->id < num_configs)
+        {
+            continue;
+        }
+        for (config_group_t *cg = MenuParent(c); cg; cg = PARENT_GROUP(cg))
+        {
+            cg->menu_gen = 0;
+        }
+    }
+    menu_built_with.num_configs = o.num_configs;
+}
+
+/*
+ * Recreate popup menus unless neither the config folders nor
+ * the settings that shape the menus have changed since last time.
+ */
+static void
+UpdatePopupMenus(void)
+{
+    if (!hMenu
+        || ConfigDirsChanged()
+        || MenuLayoutChanged())
+    {
+        RecreatePopupMenus();
+    }
 }
 
 /*
@@ -409,7 +579,7 @@ OnNotifyTray(LPARAM lParam)
     switch (LOWORD(lParam))
     {
         case WM_RBUTTONUP:
-            RecreatePopupMenus();
+            UpdatePopupMenus();
 
             GetCursorPos(&pt);
             SetForegroundWindow(o.hWnd);
@@ -421,7 +591,7 @@ OnNotifyTray(LPARAM lParam)
         {
             int disconnected_conns = CountConnState(disconnected);
 
-            RecreatePopupMenus();
+            UpdatePopupMenus();
 
             /* Start connection if only one config exist */
             if (o.num_configs == 1 && o.chead->state == disconnected)
@@ -493,7 +663,7 @@ RemoveTrayIcon()
 void
 OnDestroyTray()
 {
-    DestroyMenu(hMenu);
+    DestroyPopupMenus();
     RemoveTrayIcon();
 }
 
@@ -547,47 +717,96 @@ ShowTrayIcon()
     }
 }
 
+/* Tooltip text built in one pass: appending never rescans the string */
+typedef struct {
+    WCHAR *buf;
+    size_t size;
+    size_t len;
+} tip_text_t;
+
+/* Append str to the tooltip, truncating it when the buffer is full */
+static void
+TipAppend(tip_text_t *tip, const WCHAR *str)
+{
+    while (*str && tip->len < tip->size - 1)
+    {
+        tip->buf[tip->len++] = *str++;
+    }
+    tip->buf[tip->len] = L'\0';
+}
+
+static int
+CompareConnId(const void *a, const void *b)
+{
+    return (*(connection_t *const *) a)->id - (*(connection_t *const *) b)->id;
+}
+
+/*
+ * Append the names of connections in the given states after a heading,
+ * in the order of the config list
+ */
+static void
+TipAppendConnections(tip_text_t *tip, const WCHAR *heading, const conn_state_t *states, int n)
+{
+    connection_t **list;
+    int count = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        count += o.count_in_state[states[i]];
+    }
+    if (count == 0 || !(list = malloc(count * sizeof(*list))))
+    {
+        return;
+    }
+
+    count = 0;
+    for (i = 0; i < n; i++)
+    {
+        for (connection_t *c = o.conn_in_state[states[i]]; c; c = c->state_next)
+        {
+            list[count++] = c;
+        }
+    }
+    qsort(list, count, sizeof(*list), CompareConnId);
+
+    for (i = 0; i < count; i++)
+    {
+        TipAppend(tip, i == 0 ? heading : L", ");
+        TipAppend(tip, list[i]->config_name);
+    }
+    free(list);
+}
+
 void
 SetTrayIcon(conn_state_t state)
 {
     WCHAR tip_msg[500];
     TCHAR msg_connected[100];
     TCHAR msg_connecting[100];
-    BOOL first_conn;
+    tip_text_t tip = { tip_msg, _countof(tip_msg), 0 };
     UINT icon_id;
-    connection_t *cc = NULL; /* a connected config */
-    BOOL theme_light_system;
+    connection_t *cc = NULL; /* the only connected config */
+    static const conn_state_t connected_states[] = { connected };
+    static const conn_state_t connecting_states[] = { connecting, resuming, reconnecting };
 
     _tcsncpy(msg_connected, LoadLocalizedString(IDS_TIP_CONNECTED), _countof(msg_connected));
     _tcsncpy(msg_connecting, LoadLocalizedString(IDS_TIP_CONNECTING), _countof(msg_connecting));
 
-    wcsncpy_s(tip_msg, _countof(tip_msg), _T(PACKAGE_NAME), _TRUNCATE);
-    first_conn = TRUE;
-    for (connection_t *c = o.chead; c; c = c->next)
-    {
-        if (c->state == connected)
-        {
-            /* Append connection name to Icon Tip Msg */
-            _tcsncat(tip_msg, (first_conn ? msg_connected : _T(", ")), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            _tcsncat(tip_msg, c->config_name, _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            first_conn = FALSE;
-            cc = c;
-        }
-    }
+    TipAppend(&tip, _T(PACKAGE_NAME));
 
-    first_conn = TRUE;
-    for (connection_t *c = o.chead; c; c = c->next)
+    /* only connections listed in the tip are visited */
+    AcquireSRWLockShared(&o.state_lock);
+    TipAppendConnections(&tip, msg_connected, connected_states, _countof(connected_states));
+    TipAppendConnections(&tip, msg_connecting, connecting_states, _countof(connecting_states));
+    if (o.count_in_state[connected] == 1)
     {
-        if (c->state == connecting || c->state == resuming || c->state == reconnecting)
-        {
-            /* Append connection name to Icon Tip Msg */
-            _tcsncat(tip_msg, (first_conn ? msg_connecting : _T(", ")), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            _tcsncat(tip_msg, c->config_name, _countof(tip_msg) - _tcslen(tip_msg) - 1);
-            first_conn = FALSE;
-        }
+        cc = o.conn_in_state[connected];
     }
+    ReleaseSRWLockShared(&o.state_lock);
 
-    if (CountConnState(connected) == 1 && cc)
+    if (cc)
     {
         /* Append "Connected since and assigned IP" to message */
         TCHAR time[50];
@@ -598,19 +817,19 @@ SetTrayIcon(conn_state_t state)
          * Include about 50 characters for "Connected since:" and "Assigned IP:" prefixes.
          */
         size_t max_msglen = _countof(tip_msg) - (_countof(time) + _countof(ip) + 50);
-        if (wcslen(tip_msg)  > max_msglen && traytip)
+        if (tip.len > max_msglen && traytip)
         {
-            wcsncpy_s(&tip_msg[max_msglen-1], 2, L"…", _TRUNCATE);
+            tip.len = max_msglen - 1;
+            TipAppend(&tip, L"…");
         }
 
         LocalizedTime(cc->connected_since, time, _countof(time));
-        _tcsncat(tip_msg, LoadLocalizedString(IDS_TIP_CONNECTED_SINCE), _countof(tip_msg) - _tcslen(tip_msg) - 1);
-        _tcsncat(tip_msg, time, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+        TipAppend(&tip, LoadLocalizedString(IDS_TIP_CONNECTED_SINCE));
+        TipAppend(&tip, time);
 
         /* concatenate ipv4 and ipv6 addresses into one string */
         wcs_concat2(ip, _countof(ip), cc->ip, cc->ipv6, L", ");
-        WCHAR *assigned_ip = LoadLocalizedString(IDS_TIP_ASSIGNED_IP, ip);
-        _tcsncat(tip_msg, assigned_ip, _countof(tip_msg) - _tcslen(tip_msg) - 1);
+        TipAppend(&tip, LoadLocalizedString(IDS_TIP_ASSIGNED_IP, ip));
     }
 
     icon_id = o.is_light_theme ? ID_ICO_CONNECTING : ID_ICO_CONNECTING_DARK;
@@ -739,43 +958,49 @@ SetMenuStatus(connection_t *c, conn_state_t state)
     }
     else
     {
-        config_group_t *parent = &o.groups[0];
+        config_group_t *parent = MenuParent(c);
         int pos = c->pos;
 
-        if (USE_NESTED_CONFIG_MENU && CONFIG_GROUP(c))
-        {
-            parent = CONFIG_GROUP(c);
-        }
-        else if (c->flags & FLAG_DAEMON_PERSISTENT)
+        /* the item is set when the parent menu gets built */
+        if (parent && GroupMenuBuilt(parent))
         {
-            parent = PERSISTENT_ROOT_GROUP;
-        }
+            if (checked == 1)
+            {
+                /* Connected: use system-default check mark */
+                SetMenuItemBitmaps(parent->menu, pos,  MF_BYPOSITION, NULL, NULL);
+            }
+            else if (checked == 2)
+            {
+                /* Connecting: use our custom check mark */
+                SetMenuItemBitmaps(parent->menu, pos,  MF_BYPOSITION, NULL, hbmpConnecting);
+            }
+            CheckMenuItem(parent->menu, pos, MF_BYPOSITION | (checked ? MF_CHECKED : MF_UNCHECKED));
 
-        if (checked == 1)
-        {
-            /* Connected: use system-default check mark */
-            SetMenuItemBitmaps(parent->menu, pos,  MF_BYPOSITION, NULL, NULL);
+            PrintDebug(L"Setting state of config %ls checked = %d, parent %ls, pos %d",
+                       c->config_name, checked, (parent->id == 0) ? L"Main Menu" : L"SubMenu", pos);
         }
-        else if (checked == 2)
-        {
-            /* Connecting: use our custom check mark */
-            SetMenuItemBitmaps(parent->menu, pos,  MF_BYPOSITION, NULL, hbmpConnecting);
-        }
-        CheckMenuItem(parent->menu, pos, MF_BYPOSITION | (checked ? MF_CHECKED : MF_UNCHECKED));
-
-        PrintDebug(L"Setting state of config %ls checked = %d, parent %ls, pos %d",
-                   c->config_name, checked, (parent->id == 0) ? L"Main Menu" : L"SubMenu", pos);
 
-        if (checked) /* also check all parent groups */
+        /* also check all parent groups whose menu is built, even if the
+         * menus below them are not */
+        if (parent && checked)
         {
             while (PARENT_GROUP(parent))
             {
                 pos = parent->pos;
                 parent = PARENT_GROUP(parent);
-                CheckMenuItem(parent->menu, pos, MF_BYPOSITION | MF_CHECKED);
+                if (GroupMenuBuilt(parent))
+                {
+                    CheckMenuItem(parent->menu, pos, MF_BYPOSITION | MF_CHECKED);
+                }
             }
         }
 
+        /* nothing to do until the menu of the connection is first displayed */
+        if (i >= hmenu_size || !hMenuConn[i] || GetMenuItemCount(hMenuConn[i]) <= 0)
+        {
+            return;
+        }
+
         if (state == disconnected || state == detached)
         {
             EnableMenuItem(hMenuConn[i], IDM_CONNECTMENU, MF_ENABLED);
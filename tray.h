@@ -49,6 +49,8 @@ void RecreatePopupMenus(void);
 
 void CreatePopupMenus();
 
+void OnInitMenuPopup(HMENU);
+
 void OnNotifyTray(LPARAM);
 
 void OnDestroyTray(void);